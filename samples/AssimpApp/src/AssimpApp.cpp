@@ -47,6 +47,8 @@ class AssimpApp : public AppBasic
 		void draw();
 
 	private:
+		void measureGpuSkinningError();
+
 		assimp::AssimpLoader mAssimpLoader;
 
 		MayaCamUI mMayaCam;
@@ -56,8 +58,14 @@ class AssimpApp : public AppBasic
 		bool mEnableWireframe;
 		bool mEnableSkinning;
 		bool mEnableAnimation;
+		bool mEnableGpuSkinning;
 		bool mDrawBBox;
 		float mFps;
+
+		vector< string > mKernelNames;
+		int mKernel;
+		float mSkinningMvps;
+		float mGpuSkinningError;
 };
 
 
@@ -87,10 +95,31 @@ void AssimpApp::setup()
 	mParams.addParam( "Skinning", &mEnableSkinning );
 	mEnableAnimation = false;
 	mParams.addParam( "Animation", &mEnableAnimation );
+	mEnableGpuSkinning = false;
+	mParams.addParam( "Gpu skinning", &mEnableGpuSkinning );
 	mDrawBBox = false;
 	mParams.addParam( "Bounding box", &mDrawBBox );
+	for ( int k = assimp::SKINNING_KERNEL_SCALAR; k <= assimp::SKINNING_KERNEL_AVX; ++k )
+	{
+		if ( assimp::isSkinningKernelSupported( assimp::SkinningKernel( k ) ) )
+			mKernelNames.push_back( assimp::getSkinningKernelName( assimp::SkinningKernel( k ) ) );
+	}
+	mKernel = mKernelNames.size() - 1;
+	mParams.addParam( "Skinning kernel", mKernelNames, &mKernel );
 	mParams.addSeparator();
 	mParams.addParam( "Fps", &mFps, "", true );
+	mSkinningMvps = 0.0f;
+	mParams.addParam( "Skinning Mverts/s", &mSkinningMvps, "", true );
+	mGpuSkinningError = 0.0f;
+	mParams.addParam( "Gpu skinning error", &mGpuSkinningError, "", true );
+	mParams.addButton( "Measure gpu error", std::bind( &AssimpApp::measureGpuSkinningError, this ) );
+}
+
+void AssimpApp::measureGpuSkinningError()
+{
+	// reads the skinned meshes back from the gpu, too slow to do every frame
+	if ( mEnableGpuSkinning )
+		mGpuSkinningError = mAssimpLoader.getGpuSkinningError();
 }
 
 void AssimpApp::update()
@@ -98,12 +127,18 @@ void AssimpApp::update()
 	mAssimpLoader.enableTextures( mEnableTextures );
 	mAssimpLoader.enableSkinning( mEnableSkinning );
 	mAssimpLoader.enableAnimation( mEnableAnimation );
+	mAssimpLoader.enableGpuSkinning( mEnableGpuSkinning );
+	// supported kernels are a prefix of the enum
+	mAssimpLoader.setSkinningKernel( assimp::SkinningKernel( mKernel ) );
 
 	double time = fmod( getElapsedSeconds(), mAssimpLoader.getAnimationDuration( 0 ) );
 	mAssimpLoader.setTime( time );
 	mAssimpLoader.update();
 
 	mFps = getAverageFps();
+	if ( mAssimpLoader.getSkinningSeconds() > 0.0 )
+		mSkinningMvps = mAssimpLoader.getNumSkinnedVertices() /
+			mAssimpLoader.getSkinningSeconds() / 1e6;
 }
 
 void AssimpApp::draw()
@@ -85,13 +85,14 @@ void SkinningApp::setup()
 		mNoBones = false;
 	}
 
-	// query original node orientations from model
+	// query original node orientations from model, the node names are in
+	// the order of the node handles
 	mNodeOrientations.assign( mNodeNames.size(), Quatf() );
 	if ( !mNoBones )
 	{
 		for ( size_t i = 0; i < mNodeOrientations.size(); ++i )
 		{
-			mNodeOrientations[ i ] = mAssimpLoader.getNodeOrientation( mNodeNames[ i ] );
+			mNodeOrientations[ i ] = mAssimpLoader.getNodeOrientation( int( i ) );
 		}
 	}
 
@@ -143,8 +144,7 @@ void SkinningApp::update()
 
 	if ( !mNoBones )
 	{
-		mAssimpLoader.setNodeOrientation( mNodeNames[ mNodeIndex ],
-										  mNodeOrientations[ mNodeIndex ] );
+		mAssimpLoader.setNodeOrientation( mNodeIndex, mNodeOrientations[ mNodeIndex ] );
 	}
 
 	mAssimpLoader.update();
@@ -19,11 +19,15 @@
 */
 
 #include <assert.h>
+#include <float.h>
+#include <algorithm>
+#include <functional>
 
 #include "cinder/app/App.h"
 #include "cinder/ImageIo.h"
 #include "cinder/CinderMath.h"
 #include "cinder/Utilities.h"
+#include "cinder/Timer.h"
 
 #include "AssimpLoader.h"
 
@@ -83,12 +87,83 @@ static void fromAssimp( const aiMesh *aim, TriMesh *cim )
 	}
 }
 
-AssimpLoader::AssimpLoader( fs::path filename ) :
+//! Returns the number of nodes in the subtree of \a nd, \a nd included.
+static size_t countNodes( const aiNode *nd )
+{
+	size_t numNodes = 1;
+	for ( unsigned n = 0; n < nd->mNumChildren; ++n )
+		numNodes += countNodes( nd->mChildren[ n ] );
+	return numNodes;
+}
+
+void AssimpNode::setParent( NodeRef parent )
+{
+	if ( mPooled && parent &&
+		 ( ( parent->getHierarchy() != mHierarchy ) || ( parent->getIndex() >= mIndex ) ) )
+		throw AssimpLoaderExc( "node " + mName + " can only be parented to a preceding node of its model." );
+
+	Node::setParent( parent );
+}
+
+AssimpNodePool::AssimpNodePool( size_t numNodes ) :
+	mNodes( new vector< AssimpNode >() ),
+	mHierarchy( new NodeHierarchy() )
+{
+	mNodes->reserve( numNodes );
+}
+
+AssimpNodePool::~AssimpNodePool()
+{
+	// the children hold references to the block, which would keep it alive
+	for ( vector< AssimpNode >::iterator it = mNodes->begin(); it != mNodes->end(); ++it )
+		it->removeChildren();
+}
+
+AssimpNodeRef AssimpNodePool::addNode()
+{
+	if ( mNodes->size() == mNodes->capacity() )
+		throw AssimpLoaderExc( "node pool of " + toString< size_t >( mNodes->capacity() ) +
+				" nodes is full." );
+
+	mNodes->push_back( AssimpNode( mHierarchy ) );
+	return AssimpNodeRef( mNodes, &mNodes->back() );
+}
+
+//! Copies the original mesh data from assimp into \a vertices and \a normals.
+static void restoreMesh( const aiMesh *mesh, vector< Vec3f > &vertices, vector< Vec3f > &normals )
+{
+	for( size_t v = 0; v < vertices.size(); ++v )
+		vertices[v] = fromAssimp( mesh->mVertices[ v ] );
+
+	for( size_t v = 0; v < normals.size(); ++v )
+		normals[v] = fromAssimp( mesh->mNormals[ v ] );
+}
+
+AssimpLoader::AssimpLoader( fs::path filename, const WeightFormat &weightFormat /* = WeightFormat() */ ) :
 	mMaterialsEnabled( false ),
 	mTexturesEnabled( true ),
 	mSkinningEnabled( false ),
 	mAnimationEnabled( false ),
+	mRigidMeshesEnabled( true ),
+	mDoubleBuffered( false ),
+	mGpuSkinningEnabled( false ),
 	mFilePath( filename ),
+	mPoseGeneration( 0 ),
+	mWeightFormat( weightFormat ),
+	mPoseCacheTimeStep( 1.0 / 60.0 ),
+	mBakedAnimation( -1 ),
+	mNumBakedFrames( 0 ),
+	mBakedDuration( 0.0 ),
+	mBakeSeconds( 0.0 ),
+	mBakeNumBytes( 0 ),
+	mBakedPlayback( false ),
+	mUpdateInterval( 1 ),
+	mNumSkippedUpdates( 0 ),
+	mUpdated( false ),
+	mSkinningKernel( getBestSkinningKernel() ),
+	mSkinningSeconds( 0.0 ),
+	mNumSkinnedVertices( 0 ),
+	mSkinningChunkSize( 16384 ),
 	mAnimationIndex( 0 )
 {
 	// FIXME: aiProcessPreset_TargetRealtime_MaxQuality contains
@@ -112,7 +187,24 @@ AssimpLoader::AssimpLoader( fs::path filename ) :
 	calculateDimensions();
 
 	loadAllMeshes();
+	mNodePool = AssimpNodePoolRef( new AssimpNodePool( countNodes( mScene->mRootNode ) ) );
 	mRootNode = loadNodes( mScene->mRootNode );
+	resolveChannels();
+	mNumPrunedInfluences = 0;
+	mMaxPruneError = 0.0f;
+	resolveBones();
+	if ( mNumPrunedInfluences > 0 )
+		app::console() << "pruned " << mNumPrunedInfluences << " bone influences, maximum error " <<
+			mMaxPruneError << endl;
+
+	mPose.resize( mJointNodes.size() );
+	mDerivedPose.resize( mJointNodes.size() );
+	mJointTransforms.resize( mJointNodes.size() );
+	mLastPose.resize( mJointNodes.size() );
+	mLastJointFlags.resize( mJointNodes.size() );
+	mLastJointParents.resize( mJointNodes.size() );
+	mJointGenerations.assign( mJointNodes.size(), 0 );
+	reserveSkinningJobs();
 }
 
 void AssimpLoader::calculateDimensions()
@@ -169,13 +261,19 @@ void AssimpLoader::calculateBoundingBoxForNode( const aiNode *nd, aiVector3D *mi
 
 AssimpNodeRef AssimpLoader::loadNodes( const aiNode *nd, AssimpNodeRef parentRef )
 {
-	AssimpNodeRef nodeRef = AssimpNodeRef( new AssimpNode() );
+	AssimpNodeRef nodeRef = mNodePool->addNode();
 	nodeRef->setParent( parentRef );
 	string nodeName = fromAssimp( nd->mName );
 	nodeRef->setName( nodeName );
-	mNodeMap[ nodeName] = nodeRef;
 	mNodeNames.push_back( nodeName );
 
+	// joints are numbered in depth-first order, parents come first
+	int joint = int( mJointNodes.size() );
+	mNodeIndices[ nodeName ] = joint;
+	mJointNodes.push_back( nodeRef );
+	// the joint arrays are indexed like the pool hierarchy
+	assert( nodeRef->getIndex() == size_t( joint ) );
+
 	// store transform
 	aiVector3D scaling;
 	aiQuaternion rotation;
@@ -200,6 +298,14 @@ AssimpNodeRef AssimpLoader::loadNodes( const aiNode *nd, AssimpNodeRef parentRef
 	if ( nd->mNumMeshes > 0 )
 	{
 		mMeshNodes.push_back( nodeRef );
+
+		// meshes shared between nodes are skinned once
+		for ( size_t i = 0; i < nodeRef->mMeshes.size(); ++i )
+		{
+			if ( find( mSkinnedMeshes.begin(), mSkinnedMeshes.end(), nodeRef->mMeshes[ i ] ) ==
+					mSkinnedMeshes.end() )
+				mSkinnedMeshes.push_back( nodeRef->mMeshes[ i ] );
+		}
 	}
 
 	// process all children
@@ -211,6 +317,358 @@ AssimpNodeRef AssimpLoader::loadNodes( const aiNode *nd, AssimpNodeRef parentRef
 	return nodeRef;
 }
 
+void AssimpLoader::resolveChannels()
+{
+	mChannelJoints.resize( mScene->mNumAnimations );
+	for ( unsigned i = 0; i < mScene->mNumAnimations; ++i )
+	{
+		const aiAnimation *anim = mScene->mAnimations[ i ];
+		mChannelJoints[ i ].assign( anim->mNumChannels, -1 );
+		for ( unsigned a = 0; a < anim->mNumChannels; ++a )
+		{
+			mChannelJoints[ i ][ a ] = findNode( fromAssimp( anim->mChannels[ a ]->mNodeName ) );
+		}
+	}
+}
+
+void AssimpLoader::resolveBones()
+{
+	for ( vector< AssimpMeshRef >::const_iterator meshIt = mModelMeshes.begin();
+			meshIt != mModelMeshes.end(); ++meshIt )
+	{
+		const AssimpMeshRef &assimpMeshRef = *meshIt;
+		const aiMesh *mesh = assimpMeshRef->mAiMesh;
+
+		assimpMeshRef->mBoneJoints.resize( mesh->mNumBones );
+		assimpMeshRef->mBonePaletteIndices.resize( mesh->mNumBones );
+		for ( unsigned a = 0; a < mesh->mNumBones; ++a )
+		{
+			const aiBone *bone = mesh->mBones[ a ];
+
+			// find the corresponding joint by the name of the bone
+			string boneName = fromAssimp( bone->mName );
+			int joint = findNode( boneName );
+			if ( joint < 0 )
+				throw AssimpLoaderExc( "bone " + boneName + " of mesh " +
+						assimpMeshRef->mName + " has no node." );
+
+			assimpMeshRef->mBoneJoints[ a ] = joint;
+			assimpMeshRef->mBonePaletteIndices[ a ] =
+				getPaletteIndex( joint, fromAssimp( bone->mOffsetMatrix ) );
+		}
+
+		buildInfluences( assimpMeshRef );
+	}
+
+	mPalette.resize( mPaletteJoints.size() );
+	mPaletteGenerations.assign( mPaletteJoints.size(), 0 );
+	app::console() << mPalette.size() << " skinning matrices shared by " <<
+		mModelMeshes.size() << " meshes" << endl;
+}
+
+size_t AssimpLoader::getPaletteIndex( size_t joint, const Matrix44f &offset )
+{
+	// meshes bound to the same skeleton share the entries of their common bones
+	for ( size_t i = 0; i < mPaletteJoints.size(); ++i )
+	{
+		if ( ( mPaletteJoints[ i ] == joint ) &&
+			 equal( offset.m, offset.m + 16, mPaletteOffsets[ i ].m ) )
+			return i;
+	}
+
+	if ( mPaletteJoints.size() > 0xffff )
+		throw AssimpLoaderExc( "model has more than 65536 skinning matrices." );
+
+	mPaletteJoints.push_back( joint );
+	mPaletteOffsets.push_back( offset );
+	return mPaletteJoints.size() - 1;
+}
+
+void AssimpLoader::buildInfluences( AssimpMeshRef assimpMeshRef )
+{
+	const aiMesh *mesh = assimpMeshRef->mAiMesh;
+	if ( mesh->mNumBones > 0xffff )
+		throw AssimpLoaderExc( "mesh " + assimpMeshRef->mName + " has more than 65535 bones." );
+
+	// gather the weights of each vertex from the bones
+	vector< vector< pair< float, uint16_t > > > influences( mesh->mNumVertices );
+	for ( unsigned a = 0; a < mesh->mNumBones; ++a )
+	{
+		const aiBone *bone = mesh->mBones[ a ];
+		for ( unsigned b = 0; b < bone->mNumWeights; ++b )
+		{
+			const aiVertexWeight &weight = bone->mWeights[ b ];
+			if ( weight.mWeight > 0.0f )
+				influences[ weight.mVertexId ].push_back( make_pair( weight.mWeight, uint16_t( a ) ) );
+		}
+	}
+
+	// strongest influences first, keep at most the maximum number of them
+	// above the minimum weight, but always the strongest one
+	vector< size_t > numKept( influences.size() );
+	size_t maxInfluences = 0;
+	size_t maxKept = 0;
+	size_t numPruned = 0;
+	for ( size_t v = 0; v < influences.size(); ++v )
+	{
+		vector< pair< float, uint16_t > > &vertexInfluences = influences[ v ];
+		sort( vertexInfluences.begin(), vertexInfluences.end(),
+				greater< pair< float, uint16_t > >() );
+
+		size_t n = math< size_t >::min( vertexInfluences.size(), mWeightFormat.getMaxInfluences() );
+		while ( ( n > 1 ) && ( vertexInfluences[ n - 1 ].first < mWeightFormat.getMinWeight() ) )
+			n--;
+
+		numKept[ v ] = n;
+		maxInfluences = math< size_t >::max( maxInfluences, vertexInfluences.size() );
+		maxKept = math< size_t >::max( maxKept, n );
+		numPruned += vertexInfluences.size() - n;
+	}
+	size_t numInfluences = getSkinningNumInfluences( maxKept );
+	if ( numPruned > 0 )
+		app::console() << "mesh " << assimpMeshRef->mName << ": pruned " << numPruned <<
+			" bone influences, " << maxInfluences << " -> " << maxKept << " per vertex" << endl;
+
+	// bone matrices of the pose the nodes are loaded in to measure the error of the pruning
+	const vector< size_t > &boneJoints = assimpMeshRef->mBoneJoints;
+	vector< Matrix44f > boneMatrices( mesh->mNumBones );
+	if ( numPruned > 0 )
+	{
+		for ( unsigned a = 0; a < mesh->mNumBones; ++a )
+			boneMatrices[ a ] = mJointNodes[ boneJoints[ a ] ]->getDerivedTransform() *
+				fromAssimp( mesh->mBones[ a ]->mOffsetMatrix );
+	}
+
+	assimpMeshRef->mNumInfluences = numInfluences;
+	assimpMeshRef->mSkinningFunc = getSkinningFunc( mSkinningKernel, numInfluences, mesh->HasNormals() );
+	assimpMeshRef->mInfluenceBones.assign( mesh->mNumVertices * numInfluences, 0 );
+	assimpMeshRef->mInfluenceWeights.assign( mesh->mNumVertices * numInfluences, 0.0f );
+	for ( size_t v = 0; v < influences.size(); ++v )
+	{
+		const vector< pair< float, uint16_t > > &vertexInfluences = influences[ v ];
+		size_t n = numKept[ v ];
+
+		// the kept weights take over the weight of the dropped ones
+		float kept = 0.0f;
+		float total = 0.0f;
+		for ( size_t i = 0; i < vertexInfluences.size(); ++i )
+		{
+			total += vertexInfluences[ i ].first;
+			if ( i < n )
+				kept += vertexInfluences[ i ].first;
+		}
+		float scale = ( n < vertexInfluences.size() ) ? total / kept : 1.0f;
+
+		for ( size_t i = 0; i < n; ++i )
+		{
+			assimpMeshRef->mInfluenceBones[ v * numInfluences + i ] =
+				uint16_t( assimpMeshRef->mBonePaletteIndices[ vertexInfluences[ i ].second ] );
+			assimpMeshRef->mInfluenceWeights[ v * numInfluences + i ] = vertexInfluences[ i ].first * scale;
+		}
+
+		if ( n < vertexInfluences.size() )
+		{
+			Vec3f p = fromAssimp( mesh->mVertices[ v ] );
+			Vec3f original = Vec3f::zero();
+			Vec3f pruned = Vec3f::zero();
+			for ( size_t i = 0; i < vertexInfluences.size(); ++i )
+			{
+				Vec3f q = boneMatrices[ vertexInfluences[ i ].second ].transformPointAffine( p );
+				original += q * vertexInfluences[ i ].first;
+				if ( i < n )
+					pruned += q * ( vertexInfluences[ i ].first * scale );
+			}
+			mMaxPruneError = math< float >::max( mMaxPruneError, original.distance( pruned ) );
+		}
+	}
+	mNumPrunedInfluences += numPruned;
+
+	// vertices without weights are static, they keep their original position
+	// and only the ranges of weighted vertices are skinned
+	assimpMeshRef->mSkinnedRanges.clear();
+	for ( size_t v = 0; v < influences.size(); ++v )
+	{
+		if ( influences[ v ].empty() )
+			continue;
+
+		if ( !assimpMeshRef->mSkinnedRanges.empty() &&
+				  ( assimpMeshRef->mSkinnedRanges.back().second == v ) )
+			assimpMeshRef->mSkinnedRanges.back().second = v + 1;
+		else
+			assimpMeshRef->mSkinnedRanges.push_back( make_pair( v, v + 1 ) );
+	}
+	assimpMeshRef->mNumStaticVertices = mesh->mNumVertices;
+	for ( size_t r = 0; r < assimpMeshRef->mSkinnedRanges.size(); ++r )
+		assimpMeshRef->mNumStaticVertices -= assimpMeshRef->mSkinnedRanges[ r ].second -
+			assimpMeshRef->mSkinnedRanges[ r ].first;
+	assimpMeshRef->mNumSkinnedVertices = 0;
+	if ( ( mesh->mNumBones > 0 ) && ( assimpMeshRef->mNumStaticVertices > 0 ) )
+		app::console() << "mesh " << assimpMeshRef->mName << " has " <<
+			assimpMeshRef->mNumStaticVertices << " static vertices of " <<
+			mesh->mNumVertices << endl;
+
+	// inverse index from bones to the vertex ranges they move, short gaps of
+	// weighted vertices are bridged since skinning a few extra vertices is
+	// cheaper than another range
+	const size_t maxGap = 16;
+	vector< vector< pair< size_t, size_t > > > boneRanges( mesh->mNumBones );
+	size_t lastStatic = 0; // one after the last static vertex so far
+	for ( size_t v = 0; v < influences.size(); ++v )
+	{
+		if ( influences[ v ].empty() )
+			lastStatic = v + 1;
+
+		size_t n = math< size_t >::min( influences[ v ].size(), numInfluences );
+		for ( size_t i = 0; i < n; ++i )
+		{
+			vector< pair< size_t, size_t > > &ranges = boneRanges[ influences[ v ][ i ].second ];
+			if ( !ranges.empty() && ( v <= ranges.back().second + maxGap ) &&
+				 ( lastStatic <= ranges.back().second ) )
+				ranges.back().second = v + 1;
+			else
+				ranges.push_back( make_pair( v, v + 1 ) );
+		}
+	}
+
+	assimpMeshRef->mBoneRangeOffsets.resize( mesh->mNumBones + 1 );
+	assimpMeshRef->mBoneRanges.clear();
+	for ( size_t a = 0; a < boneRanges.size(); ++a )
+	{
+		assimpMeshRef->mBoneRangeOffsets[ a ] = assimpMeshRef->mBoneRanges.size();
+		assimpMeshRef->mBoneRanges.insert( assimpMeshRef->mBoneRanges.end(),
+				boneRanges[ a ].begin(), boneRanges[ a ].end() );
+	}
+	assimpMeshRef->mBoneRangeOffsets[ mesh->mNumBones ] = assimpMeshRef->mBoneRanges.size();
+	assimpMeshRef->mDirtyRanges.reserve( math< size_t >::max( assimpMeshRef->mBoneRanges.size(),
+				assimpMeshRef->mSkinnedRanges.size() ) );
+
+	// meshes with all vertices fully weighted to the same bone only need the
+	// bone's matrix when drawn
+	assimpMeshRef->mRigidPaletteIndex = -1;
+	if ( ( mesh->mNumBones > 0 ) && ( mesh->mNumVertices > 0 ) )
+	{
+		const vector< uint16_t > &bones = assimpMeshRef->mInfluenceBones;
+		const vector< float > &weights = assimpMeshRef->mInfluenceWeights;
+		bool rigid = true;
+		for ( size_t v = 0; rigid && ( v < mesh->mNumVertices ); ++v )
+		{
+			size_t i = v * numInfluences;
+			rigid = ( bones[ i ] == bones[ 0 ] ) &&
+					( math< float >::abs( weights[ i ] - 1.0f ) < 1e-4f ) &&
+					( ( numInfluences == 1 ) || ( weights[ i + 1 ] == 0.0f ) );
+		}
+
+		if ( rigid )
+		{
+			assimpMeshRef->mRigidPaletteIndex = bones[ 0 ];
+			app::console() << "mesh " << assimpMeshRef->mName << " is rigid, drawn with the matrix of bone " <<
+				fromAssimp( mesh->mBones[ influences[ 0 ][ 0 ].second ]->mName ) << endl;
+		}
+	}
+}
+
+bool AssimpLoader::isRigid( const AssimpMeshRef &assimpMeshRef ) const
+{
+	return mRigidMeshesEnabled && mSkinningEnabled && !mBakedPlayback &&
+		( assimpMeshRef->mRigidPaletteIndex >= 0 );
+}
+
+bool AssimpLoader::isGpuSkinned( const AssimpMeshRef &assimpMeshRef ) const
+{
+	return mGpuSkinningEnabled && mSkinningEnabled && !mBakedPlayback &&
+		assimpMeshRef->mGpuVertexVbo && !isRigid( assimpMeshRef );
+}
+
+void AssimpLoader::enableGpuSkinning( bool enable /* = true */ )
+{
+	if ( mGpuSkinningEnabled == enable )
+		return;
+
+	if ( enable && !mGpuSkinning )
+	{
+		mGpuSkinning = GpuSkinningRef( new GpuSkinning() );
+
+		vector< AssimpMeshRef >::const_iterator meshIt = mSkinnedMeshes.begin();
+		for ( ; meshIt != mSkinnedMeshes.end(); ++meshIt )
+		{
+			const AssimpMeshRef &assimpMeshRef = *meshIt;
+			if ( GpuSkinning::isSupported( assimpMeshRef ) )
+				mGpuSkinning->setup( assimpMeshRef );
+			else
+				app::console() << "mesh " << assimpMeshRef->mName << " has " <<
+					assimpMeshRef->mBoneJoints.size() << " bones, skinning it on the cpu" << endl;
+		}
+	}
+
+	mGpuSkinningEnabled = enable;
+	invalidateMeshes();
+}
+
+float AssimpLoader::getGpuSkinningError()
+{
+	if ( mGpuSkinning && !mGpuSkinning->isReadBackSupported() )
+		return -1.0f;
+
+	float error = 0.0f;
+	vector< Vec3f > gpuPositions, gpuNormals;
+	vector< Vec3f > cpuPositions, cpuNormals;
+
+	vector< AssimpMeshRef >::const_iterator meshIt = mSkinnedMeshes.begin();
+	for ( ; meshIt != mSkinnedMeshes.end(); ++meshIt )
+	{
+		const AssimpMeshRef &assimpMeshRef = *meshIt;
+		if ( !isGpuSkinned( assimpMeshRef ) )
+			continue;
+
+		mGpuSkinning->readBack( assimpMeshRef, mPalette, &gpuPositions, &gpuNormals );
+
+		// the cpu result of the same pose, static vertices keep their position
+		const aiMesh *mesh = assimpMeshRef->mAiMesh;
+		cpuPositions.resize( mesh->mNumVertices );
+		cpuNormals.resize( mesh->HasNormals() ? mesh->mNumVertices : 0 );
+		restoreMesh( mesh, cpuPositions, cpuNormals );
+
+		SkinningData data;
+		data.mPositions = mesh->mVertices;
+		data.mNormals = mesh->HasNormals() ? mesh->mNormals : NULL;
+		data.mBones = &assimpMeshRef->mInfluenceBones[ 0 ];
+		data.mWeights = &assimpMeshRef->mInfluenceWeights[ 0 ];
+		data.mNumInfluences = assimpMeshRef->mNumInfluences;
+		data.mBoneMatrices = &mPalette[ 0 ];
+		data.mSkinnedPositions = cpuPositions.empty() ? NULL : &cpuPositions[ 0 ];
+		data.mSkinnedNormals = cpuNormals.empty() ? NULL : &cpuNormals[ 0 ];
+		for ( size_t r = 0; r < assimpMeshRef->mSkinnedRanges.size(); ++r )
+			assimpMeshRef->mSkinningFunc( data, assimpMeshRef->mSkinnedRanges[ r ].first,
+					assimpMeshRef->mSkinnedRanges[ r ].second );
+
+		for ( size_t v = 0; v < cpuPositions.size(); ++v )
+			error = math< float >::max( error, cpuPositions[ v ].distance( gpuPositions[ v ] ) );
+		for ( size_t v = 0; v < cpuNormals.size(); ++v )
+			error = math< float >::max( error, cpuNormals[ v ].distance( gpuNormals[ v ] ) );
+	}
+
+	return error;
+}
+
+Matrix44f AssimpLoader::getMeshTransform( const AssimpMeshRef &assimpMeshRef ) const
+{
+	if ( !isRigid( assimpMeshRef ) )
+		return Matrix44f::identity();
+	else if ( mDoubleBuffered )
+		return mFrontPalette[ assimpMeshRef->mRigidPaletteIndex ];
+	else
+		return mPalette[ assimpMeshRef->mRigidPaletteIndex ];
+}
+
+void AssimpLoader::enableRigidMeshes( bool enable /* = true */ )
+{
+	if ( mRigidMeshesEnabled == enable )
+		return;
+
+	mRigidMeshesEnabled = enable;
+	invalidateMeshes();
+}
+
 AssimpMeshRef AssimpLoader::convertAiMesh( const aiMesh *mesh )
 {
 	// the current AssimpMesh we will be populating data into.
@@ -370,11 +828,9 @@ AssimpMeshRef AssimpLoader::convertAiMesh( const aiMesh *mesh )
 	assimpMeshRef->mAiMesh = mesh;
 	fromAssimp( mesh, &assimpMeshRef->mCachedTriMesh );
 	assimpMeshRef->mValidCache = true;
-	assimpMeshRef->mAnimatedPos.resize( mesh->mNumVertices );
-	if ( mesh->HasNormals() )
-	{
-		assimpMeshRef->mAnimatedNorm.resize( mesh->mNumVertices );
-	}
+	assimpMeshRef->mSkinnedGeneration = 0;
+	assimpMeshRef->mBackValidCache = false;
+	assimpMeshRef->mBackSkinnedGeneration = 0;
 
 
 	assimpMeshRef->mIndices.resize( mesh->mNumFaces * 3 );
@@ -413,24 +869,76 @@ void AssimpLoader::loadAllMeshes()
 	app::console() << "finished loading model " << mFilePath.filename().string() << endl;
 }
 
+void AssimpLoader::readPose()
+{
+	// the node transforms hold the user overrides and the initial pose,
+	// the nodes are loaded in joint order into the hierarchy of the pool
+	const Pose &nodePose = mNodePool->getHierarchy()->getLocalPose();
+	size_t numJoints = mPose.size();
+	copy( nodePose.mPositions.begin(), nodePose.mPositions.begin() + numJoints,
+			mPose.mPositions.begin() );
+	copy( nodePose.mOrientations.begin(), nodePose.mOrientations.begin() + numJoints,
+			mPose.mOrientations.begin() );
+	copy( nodePose.mScales.begin(), nodePose.mScales.begin() + numJoints,
+			mPose.mScales.begin() );
+}
+
 void AssimpLoader::updateAnimation( size_t animationIndex, double currentTime )
 {
 	if ( mScene->mNumAnimations == 0 )
 		return;
 
+	if ( mPoseCache )
+	{
+		int64_t tick = int64_t( math< double >::floor( currentTime / mPoseCacheTimeStep + 0.5 ) );
+		size_t clipId = mPoseCacheClipIds[ animationIndex ];
+		if ( !mPoseCache->find( clipId, tick, &mChannelPose ) )
+		{
+			Timer timer;
+			timer.start();
+			sampleAnimation( animationIndex, tick * mPoseCacheTimeStep, &mChannelPose );
+			timer.stop();
+			mPoseCache->insert( clipId, tick, mChannelPose, timer.getSeconds() );
+		}
+	}
+	else
+	{
+		sampleAnimation( animationIndex, currentTime, &mChannelPose );
+	}
+
+	applyChannelPose( animationIndex );
+}
+
+void AssimpLoader::applyChannelPose( size_t animationIndex )
+{
+	const vector< int > &channelJoints = mChannelJoints[ animationIndex ];
+	for ( size_t a = 0; a < channelJoints.size(); ++a )
+	{
+		int joint = channelJoints[ a ];
+		if ( joint < 0 )
+			continue;
+
+		mPose.mOrientations[ joint ] = mChannelPose.mOrientations[ a ];
+		mPose.mScales[ joint ] = mChannelPose.mScales[ a ];
+		mPose.mPositions[ joint ] = mChannelPose.mPositions[ a ];
+	}
+}
+
+void AssimpLoader::sampleAnimation( size_t animationIndex, double currentTime, Pose *channelPose ) const
+{
 	const aiAnimation *mAnim = mScene->mAnimations[ animationIndex ];
 	double ticks = mAnim->mTicksPerSecond;
 	if ( ticks == 0.0 )
 		ticks = 1.0;
 	currentTime *= ticks;
 
+	channelPose->resize( mAnim->mNumChannels );
+
 	// calculate the transformations for each animation channel
 	for( unsigned int a = 0; a < mAnim->mNumChannels; a++ )
 	{
 		const aiNodeAnim *channel = mAnim->mChannels[ a ];
 
-		AssimpNodeRef targetNode = getAssimpNode( fromAssimp( channel->mNodeName ) );
-
 		// ******** Position *****
 		aiVector3D presentPosition( 0, 0, 0 );
 		if( channel->mNumPositionKeys > 0 )
@@ -507,26 +1015,100 @@ void AssimpLoader::updateAnimation( size_t animationIndex, double currentTime )
 			presentScaling = channel->mScalingKeys[frame].mValue;
 		}
 
-		targetNode->setOrientation( fromAssimp( presentRotation ) );
-		targetNode->setScale( fromAssimp( presentScaling ) );
-		targetNode->setPosition( fromAssimp( presentPosition ) );
+		channelPose->mOrientations[ a ] = fromAssimp( presentRotation );
+		channelPose->mScales[ a ] = fromAssimp( presentScaling );
+		channelPose->mPositions[ a ] = fromAssimp( presentPosition );
+	}
+}
+
+static inline bool isEqual( const Quatf &a, const Quatf &b )
+{
+	return ( a.w == b.w ) && ( a.v == b.v );
+}
+
+void AssimpLoader::updateJointTransforms()
+{
+	mPoseGeneration++;
+
+	const NodeHierarchyRef &hierarchy = mNodePool->getHierarchy();
+	const vector< uint8_t > &nodeFlags = hierarchy->getFlags();
+
+	// parents precede their children, so one pass combines the whole hierarchy
+	for ( size_t i = 0; i < mJointNodes.size(); ++i )
+	{
+		const Vec3f &position = mPose.mPositions[ i ];
+		const Quatf &orientation = mPose.mOrientations[ i ];
+		const Vec3f &scale = mPose.mScales[ i ];
+		uint8_t flags = nodeFlags[ i ];
+		int parent = hierarchy->getParent( i );
+
+		// only recalculate joints which moved themselves or whose parent moved
+		bool changed = ( mJointGenerations[ i ] == 0 ) ||
+			( ( parent >= 0 ) && ( mJointGenerations[ parent ] == mPoseGeneration ) ) ||
+			( position != mLastPose.mPositions[ i ] ) ||
+			!isEqual( orientation, mLastPose.mOrientations[ i ] ) ||
+			( scale != mLastPose.mScales[ i ] ) ||
+			( flags != mLastJointFlags[ i ] ) ||
+			( parent != mLastJointParents[ i ] );
+		if ( !changed )
+			continue;
+
+		mLastPose.mPositions[ i ] = position;
+		mLastPose.mOrientations[ i ] = orientation;
+		mLastPose.mScales[ i ] = scale;
+		mLastJointFlags[ i ] = flags;
+		mLastJointParents[ i ] = parent;
+		mJointGenerations[ i ] = mPoseGeneration;
+
+		// the pose of the loader is combined like the node hierarchy does
+		NodeHierarchy::deriveNode( mPose, i, parent, flags, &mDerivedPose );
+		const Quatf &derivedOrientation = mDerivedPose.mOrientations[ i ];
+		const Vec3f &derivedPosition = mDerivedPose.mPositions[ i ];
+		const Vec3f &derivedScale = mDerivedPose.mScales[ i ];
+
+		Matrix44f &transform = mJointTransforms[ i ];
+		transform = Matrix44f::createScale( derivedScale );
+		transform *= derivedOrientation.toMatrix44();
+		transform.setTranslate( derivedPosition );
 	}
 }
 
+void AssimpLoader::getJointTransforms( Matrix44f *transforms ) const
+{
+	copy( mJointTransforms.begin(), mJointTransforms.end(), transforms );
+}
+
+int AssimpLoader::findNode( const std::string &name ) const
+{
+	unordered_map< string, size_t >::const_iterator i = mNodeIndices.find( name );
+	if ( i != mNodeIndices.end() )
+		return int( i->second );
+	else
+		return -1;
+}
+
 AssimpNodeRef AssimpLoader::getAssimpNode( const std::string &name )
 {
-	map< string, AssimpNodeRef >::iterator i = mNodeMap.find( name );
-	if ( i != mNodeMap.end() )
-		return i->second;
+	return getAssimpNode( findNode( name ) );
+}
+
+const AssimpNodeRef AssimpLoader::getAssimpNode( const std::string &name ) const
+{
+	return getAssimpNode( findNode( name ) );
+}
+
+AssimpNodeRef AssimpLoader::getAssimpNode( int node )
+{
+	if ( isValidNode( node ) )
+		return mJointNodes[ node ];
 	else
 		return AssimpNodeRef();
 }
 
-const AssimpNodeRef AssimpLoader::getAssimpNode( const std::string &name ) const
+const AssimpNodeRef AssimpLoader::getAssimpNode( int node ) const
 {
-	map< string, AssimpNodeRef >::const_iterator i = mNodeMap.find( name );
-	if ( i != mNodeMap.end() )
-		return i->second;
+	if ( isValidNode( node ) )
+		return mJointNodes[ node ];
 	else
 		return AssimpNodeRef();
 }
@@ -558,6 +1140,15 @@ const TriMesh &AssimpLoader::getAssimpNodeMesh( const string &name, size_t n /*
 		throw AssimpLoaderExc( "node " + name + " not found." );
 }
 
+Matrix44f AssimpLoader::getAssimpNodeMeshTransform( const string &name, size_t n /* = 0 */ ) const
+{
+	const AssimpNodeRef node = getAssimpNode( name );
+	if ( node && n < node->mMeshes.size() )
+		return getMeshTransform( node->mMeshes[ n ] );
+	else
+		throw AssimpLoaderExc( "node " + name + " not found." );
+}
+
 gl::Texture &AssimpLoader::getAssimpNodeTexture( const string &name, size_t n /* = 0 */ )
 {
 	AssimpNodeRef node = getAssimpNode( name );
@@ -610,6 +1201,48 @@ Quatf AssimpLoader::getNodeOrientation( const string &name )
 		return Quatf();
 }
 
+void AssimpLoader::setNodeOrientation( int node, const Quatf &rot )
+{
+	if ( isValidNode( node ) )
+		mJointNodes[ node ]->setOrientation( rot );
+}
+
+Quatf AssimpLoader::getNodeOrientation( int node ) const
+{
+	if ( isValidNode( node ) )
+		return mJointNodes[ node ]->getOrientation();
+	else
+		return Quatf();
+}
+
+void AssimpLoader::setNodePosition( int node, const Vec3f &pos )
+{
+	if ( isValidNode( node ) )
+		mJointNodes[ node ]->setPosition( pos );
+}
+
+Vec3f AssimpLoader::getNodePosition( int node ) const
+{
+	if ( isValidNode( node ) )
+		return mJointNodes[ node ]->getPosition();
+	else
+		return Vec3f::zero();
+}
+
+void AssimpLoader::setNodeScale( int node, const Vec3f &scale )
+{
+	if ( isValidNode( node ) )
+		mJointNodes[ node ]->setScale( scale );
+}
+
+Vec3f AssimpLoader::getNodeScale( int node ) const
+{
+	if ( isValidNode( node ) )
+		return mJointNodes[ node ]->getScale();
+	else
+		return Vec3f::one();
+}
+
 size_t AssimpLoader::getNumAnimations() const
 {
 	return mScene->mNumAnimations;
@@ -625,6 +1258,21 @@ void AssimpLoader::setTime( double t )
 	mAnimationTime = t;
 }
 
+void AssimpLoader::setPoseCache( PoseCacheRef cache, double timeStep /* = 1.0 / 60.0 */ )
+{
+	mPoseCache = cache;
+	mPoseCacheTimeStep = timeStep;
+	mPoseCacheClipIds.clear();
+	if ( !mPoseCache )
+		return;
+
+	for ( size_t i = 0; i < getNumAnimations(); ++i )
+	{
+		mPoseCacheClipIds.push_back( mPoseCache->getClipId( mFilePath.string() +
+					"#" + toString< size_t >( i ) ) );
+	}
+}
+
 double AssimpLoader::getAnimationDuration( size_t n ) const
 {
 	const aiAnimation *anim = mScene->mAnimations[ n ];
@@ -634,80 +1282,264 @@ double AssimpLoader::getAnimationDuration( size_t n ) const
 	return anim->mDuration / ticks;
 }
 
+static void runSkinningJobs( const vector< AssimpLoader::SkinningJob > *jobs,
+		size_t begin, size_t end )
+{
+	for ( size_t i = begin; i < end; ++i )
+	{
+		const AssimpLoader::SkinningJob &job = (*jobs)[ i ];
+		job.mFunc( job.mData, job.mBegin, job.mEnd );
+	}
+}
+
+void AssimpLoader::updatePalette()
+{
+	for ( size_t i = 0; i < mPalette.size(); ++i )
+	{
+		size_t joint = mPaletteJoints[ i ];
+		if ( mJointGenerations[ joint ] <= mPaletteGenerations[ i ] )
+			continue;
+
+		// start with the mesh-to-bone matrix
+		// and append all node transformations down the parent chain until
+		// we're back at mesh coordinates again
+		mPalette[ i ] = mJointTransforms[ joint ] * mPaletteOffsets[ i ];
+		mPaletteGenerations[ i ] = mPoseGeneration;
+	}
+}
+
 void AssimpLoader::updateSkinning()
 {
-	vector< AssimpNodeRef >::const_iterator it = mMeshNodes.begin();
-	for ( ; it != mMeshNodes.end(); ++it )
+	Timer timer;
+	timer.start();
+	updatePalette();
+	mNumSkinnedVertices = 0;
+	mSkinningJobs.clear();
+
+	vector< AssimpMeshRef >::const_iterator meshIt = mSkinnedMeshes.begin();
+	for ( ; meshIt != mSkinnedMeshes.end(); ++meshIt )
 	{
-		AssimpNodeRef nodeRef = *it;
+		const AssimpMeshRef &assimpMeshRef = *meshIt;
+
+		// current mesh we are introspecting
+		const aiMesh *mesh = assimpMeshRef->mAiMesh;
+
+		assimpMeshRef->mNumSkinnedVertices = 0;
+
+		// skin straight into the vertex arrays used for drawing, or into the
+		// back buffer when double buffering
+		vector< Vec3f > &vertices = mDoubleBuffered ? assimpMeshRef->mBackVertices :
+			assimpMeshRef->mCachedTriMesh.getVertices();
+		vector< Vec3f > &normals = mDoubleBuffered ? assimpMeshRef->mBackNormals :
+			assimpMeshRef->mCachedTriMesh.getNormals();
+		bool &validCache = mDoubleBuffered ? assimpMeshRef->mBackValidCache :
+			assimpMeshRef->mValidCache;
+		size_t &skinnedGeneration = mDoubleBuffered ? assimpMeshRef->mBackSkinnedGeneration :
+			assimpMeshRef->mSkinnedGeneration;
+
+		// rigid meshes keep their original vertices and are moved by draw()
+		if ( isRigid( assimpMeshRef ) )
+		{
+			if ( !validCache )
+			{
+				restoreMesh( mesh, vertices, normals );
+				validCache = true;
+			}
+			continue;
+		}
 
-		vector< AssimpMeshRef >::const_iterator meshIt = nodeRef->mMeshes.begin();
-		for ( ; meshIt != nodeRef->mMeshes.end(); ++meshIt )
+		// gpu skinned meshes only need the palette
+		if ( isGpuSkinned( assimpMeshRef ) )
+			continue;
+
+		// skip meshes whose bones have not moved since they were skinned,
+		// re-skin only the vertices of the moved bones if some of them did
+		const vector< size_t > &boneJoints = assimpMeshRef->mBoneJoints;
+		vector< pair< size_t, size_t > > &dirtyRanges = assimpMeshRef->mDirtyRanges;
+		dirtyRanges.clear();
+		size_t numChangedBones = 0;
+		for ( size_t a = 0; a < boneJoints.size(); ++a )
 		{
-			AssimpMeshRef assimpMeshRef = *meshIt;
+			if ( mJointGenerations[ boneJoints[ a ] ] <= skinnedGeneration )
+				continue;
+
+			numChangedBones++;
+			dirtyRanges.insert( dirtyRanges.end(),
+					assimpMeshRef->mBoneRanges.begin() + assimpMeshRef->mBoneRangeOffsets[ a ],
+					assimpMeshRef->mBoneRanges.begin() + assimpMeshRef->mBoneRangeOffsets[ a + 1 ] );
+		}
 
-			// current mesh we are introspecting
-			const aiMesh *mesh = assimpMeshRef->mAiMesh;
+		if ( validCache && ( numChangedBones == 0 ) )
+			continue;
 
-			// calculate bone matrices
-			std::vector< aiMatrix4x4 > boneMatrices( mesh->mNumBones );
-			for ( unsigned a = 0; a < mesh->mNumBones; ++a )
+		if ( !validCache || ( numChangedBones == boneJoints.size() ) )
+		{
+			// static vertices are copied once, when the cache is invalid
+			if ( !validCache )
+				restoreMesh( mesh, vertices, normals );
+			dirtyRanges.assign( assimpMeshRef->mSkinnedRanges.begin(),
+					assimpMeshRef->mSkinnedRanges.end() );
+		}
+		else
+		{
+			// merge the overlapping ranges of the bones
+			sort( dirtyRanges.begin(), dirtyRanges.end() );
+			size_t merged = 0;
+			for ( size_t r = 1; r < dirtyRanges.size(); ++r )
 			{
-				const aiBone *bone = mesh->mBones[ a ];
-
-				// find the corresponding node by again looking recursively through
-				// the node hierarchy for the same name
-				AssimpNodeRef nodeRef = getAssimpNode( fromAssimp( bone->mName ) );
-				assert( nodeRef );
-				// start with the mesh-to-bone matrix
-				// and append all node transformations down the parent chain until
-				// we're back at mesh coordinates again
-				boneMatrices[ a ] = toAssimp( nodeRef->getDerivedTransform() ) *
-										bone->mOffsetMatrix;
+				if ( dirtyRanges[ r ].first <= dirtyRanges[ merged ].second )
+					dirtyRanges[ merged ].second = math< size_t >::max( dirtyRanges[ merged ].second,
+							dirtyRanges[ r ].second );
+				else
+					dirtyRanges[ ++merged ] = dirtyRanges[ r ];
 			}
-
-			assimpMeshRef->mValidCache = false;
-
-			assimpMeshRef->mAnimatedPos.assign( assimpMeshRef->mAnimatedPos.size(),
-					aiVector3D( 0, 0, 0 ) );
-			if ( mesh->HasNormals() )
+			dirtyRanges.resize( merged + 1 );
+		}
+		skinnedGeneration = mPoseGeneration;
+		validCache = true;
+
+		SkinningJob job;
+		job.mFunc = assimpMeshRef->mSkinningFunc;
+		job.mData.mPositions = mesh->mVertices;
+		job.mData.mNormals = mesh->HasNormals() ? mesh->mNormals : NULL;
+		job.mData.mBones = assimpMeshRef->mInfluenceBones.empty() ? NULL : &assimpMeshRef->mInfluenceBones[ 0 ];
+		job.mData.mWeights = assimpMeshRef->mInfluenceWeights.empty() ? NULL : &assimpMeshRef->mInfluenceWeights[ 0 ];
+		job.mData.mNumInfluences = assimpMeshRef->mNumInfluences;
+		job.mData.mBoneMatrices = mPalette.empty() ? NULL : &mPalette[ 0 ];
+		job.mData.mSkinnedPositions = vertices.empty() ? NULL : &vertices[ 0 ];
+		job.mData.mSkinnedNormals = normals.empty() ? NULL : &normals[ 0 ];
+
+		// split large ranges into chunks, every vertex is written by one job
+		vector< pair< size_t, size_t > >::const_iterator rangeIt = dirtyRanges.begin();
+		for ( ; rangeIt != dirtyRanges.end(); ++rangeIt )
+		{
+			for ( size_t v = rangeIt->first; v < rangeIt->second; v += mSkinningChunkSize )
 			{
-				assimpMeshRef->mAnimatedNorm.assign( assimpMeshRef->mAnimatedNorm.size(),
-						aiVector3D( 0, 0, 0 ) );
+				job.mBegin = v;
+				job.mEnd = math< size_t >::min( v + mSkinningChunkSize, rangeIt->second );
+				mSkinningJobs.push_back( job );
 			}
+			assimpMeshRef->mNumSkinnedVertices += rangeIt->second - rangeIt->first;
+		}
+		mNumSkinnedVertices += assimpMeshRef->mNumSkinnedVertices;
+	}
 
-			// loop through all vertex weights of all bones
-			for ( unsigned a = 0; a < mesh->mNumBones; ++a )
-			{
-				const aiBone *bone = mesh->mBones[a];
-				const aiMatrix4x4 &posTrafo = boneMatrices[ a ];
+	if ( mSkinningThreadPool )
+	{
+		mSkinningThreadPool->parallelFor( 0, mSkinningJobs.size(),
+				bind( runSkinningJobs, &mSkinningJobs, placeholders::_1, placeholders::_2 ) );
+	}
+	else
+	{
+		runSkinningJobs( &mSkinningJobs, 0, mSkinningJobs.size() );
+	}
 
-				for ( unsigned b = 0; b < bone->mNumWeights; ++b )
-				{
-					const aiVertexWeight &weight = bone->mWeights[ b ];
-					size_t vertexId = weight.mVertexId;
-					const aiVector3D& srcPos = mesh->mVertices[vertexId];
+	timer.stop();
+	mSkinningSeconds = timer.getSeconds();
+}
 
-					assimpMeshRef->mAnimatedPos[vertexId] += weight.mWeight * (posTrafo * srcPos);
-				}
+void AssimpLoader::enableDoubleBuffering( bool enable /* = true */ )
+{
+	if ( mDoubleBuffered == enable )
+		return;
 
-				if ( mesh->HasNormals() )
-				{
-					// 3x3 matrix, contains the bone matrix without the
-					// translation, only with rotation and possibly scaling
-					aiMatrix3x3 normTrafo = aiMatrix3x3( posTrafo );
-					for ( size_t b = 0; b < bone->mNumWeights; ++b )
-					{
-						const aiVertexWeight &weight = bone->mWeights[b];
-						size_t vertexId = weight.mVertexId;
-
-						const aiVector3D& srcNorm = mesh->mNormals[vertexId];
-						assimpMeshRef->mAnimatedNorm[vertexId] += weight.mWeight * (normTrafo * srcNorm);
-					}
-				}
-			}
+	mDoubleBuffered = enable;
+	vector< AssimpMeshRef >::const_iterator meshIt = mSkinnedMeshes.begin();
+	for ( ; meshIt != mSkinnedMeshes.end(); ++meshIt )
+	{
+		const AssimpMeshRef &assimpMeshRef = *meshIt;
+		if ( enable )
+		{
+			// the back buffer starts as a copy of the front one
+			assimpMeshRef->mBackVertices = assimpMeshRef->mCachedTriMesh.getVertices();
+			assimpMeshRef->mBackNormals = assimpMeshRef->mCachedTriMesh.getNormals();
+			assimpMeshRef->mBackValidCache = assimpMeshRef->mValidCache;
+			assimpMeshRef->mBackSkinnedGeneration = assimpMeshRef->mSkinnedGeneration;
+		}
+		else
+		{
+			vector< Vec3f >().swap( assimpMeshRef->mBackVertices );
+			vector< Vec3f >().swap( assimpMeshRef->mBackNormals );
 		}
 	}
+
+	if ( enable )
+		mFrontPalette = mPalette;
+	else
+		vector< Matrix44f >().swap( mFrontPalette );
+}
+
+void AssimpLoader::swapBuffers()
+{
+	if ( !mDoubleBuffered )
+		return;
+
+	vector< AssimpMeshRef >::const_iterator meshIt = mSkinnedMeshes.begin();
+	for ( ; meshIt != mSkinnedMeshes.end(); ++meshIt )
+	{
+		const AssimpMeshRef &assimpMeshRef = *meshIt;
+		assimpMeshRef->mCachedTriMesh.getVertices().swap( assimpMeshRef->mBackVertices );
+		assimpMeshRef->mCachedTriMesh.getNormals().swap( assimpMeshRef->mBackNormals );
+		swap( assimpMeshRef->mValidCache, assimpMeshRef->mBackValidCache );
+		swap( assimpMeshRef->mSkinnedGeneration, assimpMeshRef->mBackSkinnedGeneration );
+	}
+
+	// the palette is updated incrementally, so the front one is a copy
+	copy( mPalette.begin(), mPalette.end(), mFrontPalette.begin() );
+}
+
+void AssimpLoader::setNumSkinningThreads( size_t numThreads )
+{
+	if ( numThreads > 1 )
+		mSkinningThreadPool = ThreadPoolRef( new ThreadPool( numThreads ) );
+	else
+		mSkinningThreadPool.reset();
+}
+
+size_t AssimpLoader::getNumSkinningThreads() const
+{
+	return mSkinningThreadPool ? mSkinningThreadPool->getNumThreads() : 1;
+}
+
+void AssimpLoader::setSkinningChunkSize( size_t numVertices )
+{
+	mSkinningChunkSize = math< size_t >::max( numVertices, 1 );
+	reserveSkinningJobs();
+}
+
+void AssimpLoader::reserveSkinningJobs()
+{
+	// the merged dirty ranges of a mesh are disjoint, every range adds at most
+	// one partial chunk to the chunks of the skinned vertices, so updateSkinning()
+	// never grows the job list
+	size_t numJobs = 0;
+	vector< AssimpMeshRef >::const_iterator meshIt = mSkinnedMeshes.begin();
+	for ( ; meshIt != mSkinnedMeshes.end(); ++meshIt )
+	{
+		const AssimpMeshRef &assimpMeshRef = *meshIt;
+		size_t numRanges = math< size_t >::max( assimpMeshRef->mBoneRanges.size(),
+				assimpMeshRef->mSkinnedRanges.size() );
+		size_t numSkinnedVertices = assimpMeshRef->mAiMesh->mNumVertices -
+			assimpMeshRef->mNumStaticVertices;
+		numJobs += numRanges + numSkinnedVertices / mSkinningChunkSize;
+	}
+	mSkinningJobs.reserve( numJobs );
+}
+
+void AssimpLoader::setSkinningKernel( SkinningKernel kernel )
+{
+	if ( !isSkinningKernelSupported( kernel ) )
+		throw AssimpLoaderExc( string( "skinning kernel " ) +
+				getSkinningKernelName( kernel ) + " is not supported by the cpu." );
+	mSkinningKernel = kernel;
+
+	for ( vector< AssimpMeshRef >::const_iterator meshIt = mModelMeshes.begin();
+			meshIt != mModelMeshes.end(); ++meshIt )
+	{
+		const AssimpMeshRef &assimpMeshRef = *meshIt;
+		assimpMeshRef->mSkinningFunc = getSkinningFunc( kernel, assimpMeshRef->mNumInfluences,
+				assimpMeshRef->mAiMesh->HasNormals() );
+	}
 }
 
 void AssimpLoader::updateMeshes()
@@ -715,78 +1547,381 @@ void AssimpLoader::updateMeshes()
 	vector< AssimpNodeRef >::iterator it = mMeshNodes.begin();
 	for ( ; it != mMeshNodes.end(); ++it )
 	{
-		AssimpNodeRef nodeRef = *it;
+		const AssimpNodeRef &nodeRef = *it;
 
 		vector< AssimpMeshRef >::iterator meshIt = nodeRef->mMeshes.begin();
 		for ( ; meshIt != nodeRef->mMeshes.end(); ++meshIt )
 		{
-			AssimpMeshRef assimpMeshRef = *meshIt;
+			const AssimpMeshRef &assimpMeshRef = *meshIt;
 
-			if ( assimpMeshRef->mValidCache )
+			// skinned meshes are written by updateSkinning() directly
+			bool &validCache = mDoubleBuffered ? assimpMeshRef->mBackValidCache :
+				assimpMeshRef->mValidCache;
+			if ( validCache || mSkinningEnabled )
 				continue;
 
-			if ( mSkinningEnabled )
+			restoreMesh( assimpMeshRef->mAiMesh,
+					mDoubleBuffered ? assimpMeshRef->mBackVertices : assimpMeshRef->mCachedTriMesh.getVertices(),
+					mDoubleBuffered ? assimpMeshRef->mBackNormals : assimpMeshRef->mCachedTriMesh.getNormals() );
+			validCache = true;
+		}
+	}
+}
+
+void AssimpLoader::enableSkinning( bool enable /* = true */ )
+{
+	if ( mSkinningEnabled == enable )
+		return;
+
+	mSkinningEnabled = enable;
+	invalidateMeshes();
+}
+
+void AssimpLoader::invalidateMeshes()
+{
+	vector< AssimpNodeRef >::const_iterator it = mMeshNodes.begin();
+	for ( ; it != mMeshNodes.end(); ++it )
+	{
+		const AssimpNodeRef &nodeRef = *it;
+
+		vector< AssimpMeshRef >::const_iterator meshIt = nodeRef->mMeshes.begin();
+		for ( ; meshIt != nodeRef->mMeshes.end(); ++meshIt )
+		{
+			const AssimpMeshRef &assimpMeshRef = *meshIt;
+			assimpMeshRef->mValidCache = false;
+			assimpMeshRef->mBackValidCache = false;
+		}
+	}
+}
+
+void AssimpLoader::skinBakedFrame( size_t animationIndex, double time )
+{
+	// sampled directly, the one-off poses would only pollute the pose cache
+	readPose();
+	sampleAnimation( animationIndex, time, &mChannelPose );
+	applyChannelPose( animationIndex );
+	updateJointTransforms();
+	updateSkinning();
+}
+
+bool AssimpLoader::bakeAnimation( size_t n, const BakeFormat &format /* = BakeFormat() */ )
+{
+	if ( n >= getNumAnimations() )
+		return false;
+
+	Timer timer;
+	timer.start();
+
+	double duration = getAnimationDuration( n );
+	size_t numFrames = size_t( math< double >::ceil( duration * format.getFps() ) );
+	numFrames = math< size_t >::max( numFrames, 1 );
+
+	size_t numVertices = 0;
+	size_t numNormals = 0;
+	for ( vector< AssimpMeshRef >::const_iterator meshIt = mModelMeshes.begin();
+			meshIt != mModelMeshes.end(); ++meshIt )
+	{
+		const aiMesh *mesh = (*meshIt)->mAiMesh;
+		numVertices += mesh->mNumVertices;
+		if ( mesh->HasNormals() )
+			numNormals += mesh->mNumVertices;
+	}
+
+	// the frames are written straight into their final format, so this is
+	// the peak memory of the bake as well
+	size_t numBytes;
+	if ( format.getQuantize() )
+		numBytes = numFrames * ( numVertices * 3 * sizeof( uint16_t ) + numNormals * 3 * sizeof( int8_t ) );
+	else
+		numBytes = numFrames * ( numVertices + numNormals ) * sizeof( Vec3f );
+	if ( numBytes > format.getMaxBytes() )
+		return false;
+
+	clearBakedAnimation();
+
+	// skin every frame with the regular cpu pipeline, rigid and gpu skinned
+	// meshes included
+	bool rigidMeshesEnabled = mRigidMeshesEnabled;
+	bool gpuSkinningEnabled = mGpuSkinningEnabled;
+	bool doubleBuffered = mDoubleBuffered;
+	mRigidMeshesEnabled = false;
+	mGpuSkinningEnabled = false;
+	mDoubleBuffered = false;
+	invalidateMeshes();
+
+	// quantizing needs the bounds of the positions over all frames, which
+	// are found by a first pass skinning the frames without storing them
+	if ( format.getQuantize() )
+	{
+		vector< Vec3f > minPositions( mModelMeshes.size(), Vec3f( FLT_MAX, FLT_MAX, FLT_MAX ) );
+		vector< Vec3f > maxPositions( mModelMeshes.size(), Vec3f( -FLT_MAX, -FLT_MAX, -FLT_MAX ) );
+		for ( size_t f = 0; f < numFrames; ++f )
+		{
+			skinBakedFrame( n, f * duration / numFrames );
+			for ( size_t m = 0; m < mModelMeshes.size(); ++m )
 			{
-				// animated data
-				std::vector< Vec3f > &vertices = assimpMeshRef->mCachedTriMesh.getVertices();
-				for( size_t v = 0; v < vertices.size(); ++v )
-					vertices[v] = fromAssimp( assimpMeshRef->mAnimatedPos[ v ] );
-
-				std::vector< Vec3f > &normals = assimpMeshRef->mCachedTriMesh.getNormals();
-				for( size_t v = 0; v < normals.size(); ++v )
-					normals[v] = fromAssimp( assimpMeshRef->mAnimatedNorm[ v ] );
+				const vector< Vec3f > &vertices = mModelMeshes[ m ]->mCachedTriMesh.getVertices();
+				for ( size_t v = 0; v < vertices.size(); ++v )
+				{
+					const Vec3f &p = vertices[ v ];
+					minPositions[ m ] = Vec3f( math< float >::min( minPositions[ m ].x, p.x ),
+											   math< float >::min( minPositions[ m ].y, p.y ),
+											   math< float >::min( minPositions[ m ].z, p.z ) );
+					maxPositions[ m ] = Vec3f( math< float >::max( maxPositions[ m ].x, p.x ),
+											   math< float >::max( maxPositions[ m ].y, p.y ),
+											   math< float >::max( maxPositions[ m ].z, p.z ) );
+				}
 			}
-			else
-			{
-				// original mesh data from assimp
-				const aiMesh *mesh = assimpMeshRef->mAiMesh;
+		}
 
-				std::vector< Vec3f > &vertices = assimpMeshRef->mCachedTriMesh.getVertices();
-				for( size_t v = 0; v < vertices.size(); ++v )
-					vertices[v] = fromAssimp( mesh->mVertices[ v ] );
+		for ( size_t m = 0; m < mModelMeshes.size(); ++m )
+		{
+			BakedFrames &baked = mModelMeshes[ m ]->mBakedFrames;
+			if ( mModelMeshes[ m ]->mAiMesh->mNumVertices == 0 )
+				continue;
+			baked.mOrigin = minPositions[ m ];
+			baked.mStep = ( maxPositions[ m ] - minPositions[ m ] ) / 65535.0f;
+		}
+	}
 
-				std::vector< Vec3f > &normals = assimpMeshRef->mCachedTriMesh.getNormals();
-				for( size_t v = 0; v < normals.size(); ++v )
-					normals[v] = fromAssimp( mesh->mNormals[ v ] );
+	for ( vector< AssimpMeshRef >::const_iterator meshIt = mModelMeshes.begin();
+			meshIt != mModelMeshes.end(); ++meshIt )
+	{
+		BakedFrames &baked = (*meshIt)->mBakedFrames;
+		const aiMesh *mesh = (*meshIt)->mAiMesh;
+		baked.mNumVertices = mesh->mNumVertices;
+		size_t numMeshNormals = mesh->HasNormals() ? mesh->mNumVertices : 0;
+		if ( format.getQuantize() )
+		{
+			baked.mQuantizedPositions.reserve( numFrames * mesh->mNumVertices * 3 );
+			baked.mQuantizedNormals.reserve( numFrames * numMeshNormals * 3 );
+		}
+		else
+		{
+			baked.mPositions.reserve( numFrames * mesh->mNumVertices );
+			baked.mNormals.reserve( numFrames * numMeshNormals );
+		}
+	}
+
+	// the frames divide the clip evenly, so the baked loop is as long as the
+	// clip and its last frame blends into the first one
+	for ( size_t f = 0; f < numFrames; ++f )
+	{
+		skinBakedFrame( n, f * duration / numFrames );
+
+		for ( vector< AssimpMeshRef >::const_iterator meshIt = mModelMeshes.begin();
+				meshIt != mModelMeshes.end(); ++meshIt )
+		{
+			const AssimpMeshRef &assimpMeshRef = *meshIt;
+			BakedFrames &baked = assimpMeshRef->mBakedFrames;
+			const TriMesh &triMesh = assimpMeshRef->mCachedTriMesh;
+			if ( !format.getQuantize() )
+			{
+				baked.mPositions.insert( baked.mPositions.end(),
+						triMesh.getVertices().begin(), triMesh.getVertices().end() );
+				baked.mNormals.insert( baked.mNormals.end(),
+						triMesh.getNormals().begin(), triMesh.getNormals().end() );
+				continue;
+			}
+
+			Vec3f invStep( baked.mStep.x > 0.0f ? 1.0f / baked.mStep.x : 0.0f,
+						   baked.mStep.y > 0.0f ? 1.0f / baked.mStep.y : 0.0f,
+						   baked.mStep.z > 0.0f ? 1.0f / baked.mStep.z : 0.0f );
+			const vector< Vec3f > &vertices = triMesh.getVertices();
+			for ( size_t v = 0; v < vertices.size(); ++v )
+			{
+				Vec3f q = ( vertices[ v ] - baked.mOrigin ) * invStep;
+				baked.mQuantizedPositions.push_back( uint16_t( q.x + 0.5f ) );
+				baked.mQuantizedPositions.push_back( uint16_t( q.y + 0.5f ) );
+				baked.mQuantizedPositions.push_back( uint16_t( q.z + 0.5f ) );
 			}
 
-			assimpMeshRef->mValidCache = true;
+			const vector< Vec3f > &normals = triMesh.getNormals();
+			for ( size_t v = 0; v < normals.size(); ++v )
+			{
+				Vec3f n = normals[ v ];
+				n.safeNormalize();
+				n *= 127.0f;
+				baked.mQuantizedNormals.push_back( int8_t( math< float >::floor( n.x + 0.5f ) ) );
+				baked.mQuantizedNormals.push_back( int8_t( math< float >::floor( n.y + 0.5f ) ) );
+				baked.mQuantizedNormals.push_back( int8_t( math< float >::floor( n.z + 0.5f ) ) );
+			}
 		}
 	}
+
+	mBakedAnimation = int( n );
+	mBakeFormat = format;
+	mNumBakedFrames = numFrames;
+	mBakedDuration = duration;
+	mBakeNumBytes = numBytes;
+	mRigidMeshesEnabled = rigidMeshesEnabled;
+	mGpuSkinningEnabled = gpuSkinningEnabled;
+	mDoubleBuffered = doubleBuffered;
+	invalidateMeshes();
+
+	timer.stop();
+	mBakeSeconds = timer.getSeconds();
+	app::console() << "baked animation " << n << ": " << numFrames << " frames, " <<
+		mBakeNumBytes << " bytes, " << mBakeSeconds << " seconds" << endl;
+	return true;
 }
 
-void AssimpLoader::enableSkinning( bool enable /* = true */ )
+void AssimpLoader::clearBakedAnimation()
 {
-	if ( mSkinningEnabled == enable )
-		return;
+	for ( vector< AssimpMeshRef >::const_iterator meshIt = mModelMeshes.begin();
+			meshIt != mModelMeshes.end(); ++meshIt )
+	{
+		(*meshIt)->mBakedFrames = BakedFrames();
+	}
+
+	mBakedAnimation = -1;
+	mNumBakedFrames = 0;
+	mBakedDuration = 0.0;
+	mBakeNumBytes = 0;
+	if ( mBakedPlayback )
+	{
+		mBakedPlayback = false;
+		invalidateMeshes();
+	}
+}
+
+static void decodeBakedFrame( const BakedFrames &baked, size_t frame, bool normals, size_t v, Vec3f *out )
+{
+	size_t i = frame * baked.mNumVertices + v;
+	if ( baked.mQuantizedPositions.empty() && baked.mQuantizedNormals.empty() )
+	{
+		*out = normals ? baked.mNormals[ i ] : baked.mPositions[ i ];
+	}
+	else if ( normals )
+	{
+		const int8_t *q = &baked.mQuantizedNormals[ i * 3 ];
+		*out = Vec3f( q[ 0 ], q[ 1 ], q[ 2 ] ) / 127.0f;
+	}
+	else
+	{
+		const uint16_t *q = &baked.mQuantizedPositions[ i * 3 ];
+		*out = baked.mOrigin + Vec3f( q[ 0 ], q[ 1 ], q[ 2 ] ) * baked.mStep;
+	}
+}
+
+void AssimpLoader::updateBakedMeshes( double currentTime )
+{
+	// the baked loop is as long as the clip, whose duration need not be a
+	// whole number of frames
+	double frame = 0.0;
+	if ( mBakedDuration > 0.0 )
+		frame = math< double >::fmod( currentTime / mBakedDuration * mNumBakedFrames, double( mNumBakedFrames ) );
+	if ( frame < 0.0 )
+		frame += mNumBakedFrames;
+	size_t frame0 = math< size_t >::min( size_t( frame ), mNumBakedFrames - 1 );
+	// looping clip, the last frame blends into the first one
+	size_t frame1 = ( frame0 + 1 ) % mNumBakedFrames;
+	float t = mBakeFormat.getInterpolate() ? float( frame - frame0 ) : 0.0f;
 
-	mSkinningEnabled = enable;
-	// invalidate mesh cache
 	vector< AssimpNodeRef >::const_iterator it = mMeshNodes.begin();
 	for ( ; it != mMeshNodes.end(); ++it )
 	{
-		AssimpNodeRef nodeRef = *it;
+		const AssimpNodeRef &nodeRef = *it;
 
 		vector< AssimpMeshRef >::const_iterator meshIt = nodeRef->mMeshes.begin();
 		for ( ; meshIt != nodeRef->mMeshes.end(); ++meshIt )
 		{
-			AssimpMeshRef assimpMeshRef = *meshIt;
-			assimpMeshRef->mValidCache = false;
+			const AssimpMeshRef &assimpMeshRef = *meshIt;
+			const BakedFrames &baked = assimpMeshRef->mBakedFrames;
+
+			// decode into the back buffer when double buffering, like updateSkinning()
+			std::vector< Vec3f > &vertices = mDoubleBuffered ? assimpMeshRef->mBackVertices :
+				assimpMeshRef->mCachedTriMesh.getVertices();
+			std::vector< Vec3f > &normals = mDoubleBuffered ? assimpMeshRef->mBackNormals :
+				assimpMeshRef->mCachedTriMesh.getNormals();
+			Vec3f a, b;
+			for ( size_t v = 0; v < vertices.size(); ++v )
+			{
+				decodeBakedFrame( baked, frame0, false, v, &a );
+				if ( t > 0.0f )
+				{
+					decodeBakedFrame( baked, frame1, false, v, &b );
+					a += ( b - a ) * t;
+				}
+				vertices[ v ] = a;
+			}
+
+			for ( size_t v = 0; v < normals.size(); ++v )
+			{
+				decodeBakedFrame( baked, frame0, true, v, &a );
+				if ( t > 0.0f )
+				{
+					decodeBakedFrame( baked, frame1, true, v, &b );
+					a += ( b - a ) * t;
+				}
+				normals[ v ] = a;
+			}
+
+			if ( mDoubleBuffered )
+				assimpMeshRef->mBackValidCache = true;
+			else
+				assimpMeshRef->mValidCache = true;
 		}
 	}
 }
 
 void AssimpLoader::update()
 {
+	// the first update is done, so the model does not wait in the bind pose
+	if ( mUpdated && ( mNumSkippedUpdates + 1 < mUpdateInterval ) )
+	{
+		skipUpdate();
+		return;
+	}
+	mNumSkippedUpdates = 0;
+	mUpdated = true;
+
+	if ( mAnimationEnabled && mSkinningEnabled &&
+		 ( mBakedAnimation == int( mAnimationIndex ) ) )
+	{
+		updateBakedMeshes( mAnimationTime );
+		mBakedPlayback = true;
+		return;
+	}
+	else if ( mBakedPlayback )
+	{
+		mBakedPlayback = false;
+		invalidateMeshes();
+	}
+
+	if ( mAnimationEnabled || mSkinningEnabled )
+		readPose();
+
 	if ( mAnimationEnabled )
 		updateAnimation( mAnimationIndex, mAnimationTime );
 
 	if ( mSkinningEnabled )
+	{
+		updateJointTransforms();
 		updateSkinning();
+	}
 
 	updateMeshes();
 }
 
+static void updateInstances( const vector< AssimpInstance > *instances, size_t begin, size_t end )
+{
+	for ( size_t i = begin; i < end; ++i )
+	{
+		AssimpLoader *loader = (*instances)[ i ].mLoader;
+		loader->setTime( (*instances)[ i ].mTime );
+		loader->update();
+	}
+}
+
+void AssimpLoader::updateBatch( const vector< AssimpInstance > &instances, ThreadPool &pool )
+{
+	// every instance is updated by exactly one thread and only touches its
+	// own data, so the result does not depend on the scheduling
+	pool.parallelFor( 0, instances.size(),
+			bind( updateInstances, &instances, placeholders::_1, placeholders::_2 ) );
+}
+
 void AssimpLoader::draw()
 {
 	glPushAttrib( GL_ALL_ATTRIB_BITS );
@@ -796,12 +1931,12 @@ void AssimpLoader::draw()
 	vector< AssimpNodeRef >::const_iterator it = mMeshNodes.begin();
 	for ( ; it != mMeshNodes.end(); ++it )
 	{
-		AssimpNodeRef nodeRef = *it;
+		const AssimpNodeRef &nodeRef = *it;
 
 		vector< AssimpMeshRef >::const_iterator meshIt = nodeRef->mMeshes.begin();
 		for ( ; meshIt != nodeRef->mMeshes.end(); ++meshIt )
 		{
-			AssimpMeshRef assimpMeshRef = *meshIt;
+			const AssimpMeshRef &assimpMeshRef = *meshIt;
 
 			// Texture Binding
 			if ( mTexturesEnabled && assimpMeshRef->mTexture )
@@ -824,7 +1959,22 @@ void AssimpLoader::draw()
 			else
 				gl::disable( GL_CULL_FACE );
 
-			gl::draw( assimpMeshRef->mCachedTriMesh );
+			if ( isGpuSkinned( assimpMeshRef ) )
+			{
+				mGpuSkinning->draw( assimpMeshRef, mDoubleBuffered ? mFrontPalette : mPalette,
+						mTexturesEnabled && assimpMeshRef->mTexture );
+			}
+			else if ( isRigid( assimpMeshRef ) )
+			{
+				gl::pushModelView();
+				gl::multModelView( getMeshTransform( assimpMeshRef ) );
+				gl::draw( assimpMeshRef->mCachedTriMesh );
+				gl::popModelView();
+			}
+			else
+			{
+				gl::draw( assimpMeshRef->mCachedTriMesh );
+			}
 
 			// Texture Binding
 			if ( mTexturesEnabled && assimpMeshRef->mTexture )
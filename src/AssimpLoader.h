@@ -18,6 +18,7 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 
 /* 2.0
 #include "assimp/assimp.hpp"
@@ -35,9 +36,15 @@
 #include "cinder/TriMesh.h"
 #include "cinder/Stream.h"
 #include "cinder/AxisAlignedBox.h"
+#include "cinder/CinderMath.h"
 
 #include "Node.h"
+#include "Pose.h"
+#include "PoseCache.h"
 #include "AssimpMesh.h"
+#include "SkinningKernels.h"
+#include "GpuSkinning.h"
+#include "ThreadPool.h"
 
 namespace mndl { namespace assimp {
 
@@ -115,43 +122,200 @@ class AssimpLoaderExc : public std::exception
 class AssimpNode : public mndl::Node
 {
 	public:
+		AssimpNode() : mPooled( false ) {}
+		//! Creates a node of a loaded model in the pool \a hierarchy.
+		explicit AssimpNode( const mndl::NodeHierarchyRef &hierarchy ) : mndl::Node( hierarchy ), mPooled( true ) {}
+
+		/** The loader indexes its joints by their entries in the pool hierarchy,
+		  so the nodes of a loaded model can only be parented to a preceding
+		  node of the model, which keeps the entries in place. Throws
+		  AssimpLoaderExc for other parents. */
+		void setParent( mndl::NodeRef parent );
+
 		std::vector< AssimpMeshRef > mMeshes;
+
+	private:
+		bool mPooled; /// node of a loaded model, stored in an AssimpNodePool
 };
 
 typedef std::shared_ptr< AssimpNode > AssimpNodeRef;
 
+class AssimpNodePool;
+
+typedef std::shared_ptr< AssimpNodePool > AssimpNodePoolRef;
+
+/** Stores the nodes of a model in one block sharing one NodeHierarchy.
+  The references handed out keep the block alive. When the pool is
+  destroyed, the links between the nodes are removed, so the block is
+  released at once after the last outside reference is gone.
+  */
+class AssimpNodePool
+{
+	public:
+		//! Creates a pool with room for \a numNodes nodes.
+		AssimpNodePool( size_t numNodes );
+		~AssimpNodePool();
+
+		//! Adds a root node, throws AssimpLoaderExc if the pool is full.
+		AssimpNodeRef addNode();
+
+		size_t getNumNodes() const { return mNodes->size(); }
+		const mndl::NodeHierarchyRef &getHierarchy() const { return mHierarchy; }
+
+	private:
+		AssimpNodePool( const AssimpNodePool & );
+		AssimpNodePool &operator=( const AssimpNodePool & );
+
+		std::shared_ptr< std::vector< AssimpNode > > mNodes; /// never reallocated, the nodes are referenced by address
+		mndl::NodeHierarchyRef mHierarchy;
+};
+
+class AssimpLoader;
+
+//! Model and its animation time for AssimpLoader::updateBatch() and UpdateScheduler.
+struct AssimpInstance
+{
+	AssimpInstance( AssimpLoader *loader, double time, float priority = 1.0f ) :
+		mLoader( loader ), mTime( time ), mPriority( priority ) {}
+
+	AssimpLoader *mLoader;
+	double mTime;
+	//! Importance of the instance for UpdateScheduler, for example its size on screen.
+	float mPriority;
+};
+
 class AssimpLoader
 {
 	public:
+		//! Options for bakeAnimation().
+		class BakeFormat
+		{
+			public:
+				BakeFormat() : mFps( 30.0f ), mQuantize( false ),
+					mInterpolate( true ), mMaxBytes( 64 * 1024 * 1024 ) {}
+
+				//! Sets the number of baked frames per second.
+				BakeFormat &setFps( float fps ) { mFps = fps; return *this; }
+				float getFps() const { return mFps; }
+
+				//! Stores positions as 16-bit and normals as 8-bit integers.
+				BakeFormat &setQuantize( bool quantize = true ) { mQuantize = quantize; return *this; }
+				bool getQuantize() const { return mQuantize; }
+
+				//! Interpolates between the baked frames on playback.
+				BakeFormat &setInterpolate( bool interpolate = true ) { mInterpolate = interpolate; return *this; }
+				bool getInterpolate() const { return mInterpolate; }
+
+				//! Sets the maximum memory used by the baked frames in bytes.
+				BakeFormat &setMaxBytes( size_t maxBytes ) { mMaxBytes = maxBytes; return *this; }
+				size_t getMaxBytes() const { return mMaxBytes; }
+
+			private:
+				float mFps;
+				bool mQuantize;
+				bool mInterpolate;
+				size_t mMaxBytes;
+		};
+
+		//! Bone weight options applied when loading a model.
+		class WeightFormat
+		{
+			public:
+				WeightFormat() : mMaxInfluences( 8 ), mMinWeight( 0.0f ) {}
+
+				//! Keeps at most the \a n strongest bone influences per vertex, 1 to 8.
+				WeightFormat &setMaxInfluences( size_t n ) { mMaxInfluences = ci::math< size_t >::clamp( n, 1, 8 ); return *this; }
+				size_t getMaxInfluences() const { return mMaxInfluences; }
+
+				//! Drops influences with weights below \a weight, except for the strongest one of each vertex.
+				WeightFormat &setMinWeight( float weight ) { mMinWeight = weight; return *this; }
+				float getMinWeight() const { return mMinWeight; }
+
+			private:
+				size_t mMaxInfluences;
+				float mMinWeight;
+		};
+
 		AssimpLoader() {}
 
-		//! Constructs and does the parsing of the file from \a filename.
-		AssimpLoader( ci::fs::path filename );
+		/** Constructs and does the parsing of the file from \a filename.
+		  Bone influences are pruned according to \a weightFormat, the kept
+		  weights of a vertex are scaled to the sum of all of its weights. */
+		AssimpLoader( ci::fs::path filename, const WeightFormat &weightFormat = WeightFormat() );
 
-		//! Updates model animation and skinning.
+		//! Returns the number of bone influences removed at load.
+		size_t getNumPrunedInfluences() const { return mNumPrunedInfluences; }
+		//! Returns the largest vertex displacement caused by the pruning in the pose the model was loaded in.
+		float getMaxPruneError() const { return mMaxPruneError; }
+
+		/** Updates model animation and skinning, unless it is skipped by the
+		  update interval. Once the first update has sized the buffers, update()
+		  and draw() allocate no memory, except when the pose cache misses. */
 		void update();
+		//! Skips an update, the model keeps its last pose.
+		void skipUpdate() { mNumSkippedUpdates++; }
+		//! Returns the number of updates skipped since the last one that was done.
+		size_t getNumSkippedUpdates() const { return mNumSkippedUpdates; }
+
+		//! Updates the model on every \a n'th call of update() only, starting with the first call.
+		void setUpdateInterval( size_t n ) { mUpdateInterval = ci::math< size_t >::max( n, 1 ); }
+		size_t getUpdateInterval() const { return mUpdateInterval; }
 		//! Draws all meshes in the model.
 		void draw();
 
+		/** Sets the time of all \a instances and updates their animation and
+		  skinning in parallel on \a pool. The models must be loaded separately,
+		  because copies of the same AssimpLoader share their nodes. */
+		static void updateBatch( const std::vector< AssimpInstance > &instances, ThreadPool &pool );
+
 		//! Returns the bounding box of the static, not skinned mesh.
 		ci::AxisAlignedBox3f getBoundingBox() const { return mBoundingBox; }
 
+		/** Returns the handle of the node called \a name, or -1 if there is no
+		  such node. Handles are the joint indices, the index of the name in
+		  getNodeNames(), and stay valid as long as the model is loaded. Look
+		  them up once, the accessors taking a handle do not touch any strings.
+		  */
+		int findNode( const std::string &name ) const;
+
 		//! Sets the orientation of this node via a quaternion.
 		void setNodeOrientation( const std::string &name, const ci::Quatf &rot );
 		//! Returns a quaternion representing the orientation of the node called \a name.
 		ci::Quatf getNodeOrientation( const std::string &name );
 
+		//! Sets the orientation of the node with the handle \a node. Invalid handles are ignored.
+		void setNodeOrientation( int node, const ci::Quatf &rot );
+		//! Returns the orientation of the node with the handle \a node, or the identity for invalid handles.
+		ci::Quatf getNodeOrientation( int node ) const;
+		//! Sets the position of the node with the handle \a node. Invalid handles are ignored.
+		void setNodePosition( int node, const ci::Vec3f &pos );
+		//! Returns the position of the node with the handle \a node, or zero for invalid handles.
+		ci::Vec3f getNodePosition( int node ) const;
+		//! Sets the scale of the node with the handle \a node. Invalid handles are ignored.
+		void setNodeScale( int node, const ci::Vec3f &scale );
+		//! Returns the scale of the node with the handle \a node, or one for invalid handles.
+		ci::Vec3f getNodeScale( int node ) const;
+
 		//! Returns the node called \a name.
 		AssimpNodeRef getAssimpNode( const std::string &name );
 		//! Returns the node called \a name.
 		const AssimpNodeRef getAssimpNode( const std::string &name ) const;
+		//! Returns the node with the handle \a node, or an empty ref for invalid handles.
+		AssimpNodeRef getAssimpNode( int node );
+		//! Returns the node with the handle \a node, or an empty ref for invalid handles.
+		const AssimpNodeRef getAssimpNode( int node ) const;
 
 		//! Returns the total number of meshes contained by the node called \a name.
 		size_t getAssimpNodeNumMeshes( const std::string &name );
-		//! Returns the \a n'th cinder::TriMesh contained by the node called \a name.
+		/** Returns the \a n'th cinder::TriMesh contained by the node called \a name.
+		  While rigid meshes are enabled, meshes bound to a single bone keep
+		  their bind pose vertices, place them with getAssimpNodeMeshTransform()
+		  or call disableRigidMeshes() to have them skinned. */
 		ci::TriMesh &getAssimpNodeMesh( const std::string &name, size_t n = 0 );
-		//! Returns the \a n'th cinder::TriMesh contained by the node called \a name.
+		//! Returns the \a n'th cinder::TriMesh contained by the node called \a name, see above for rigid meshes.
 		const ci::TriMesh &getAssimpNodeMesh( const std::string &name, size_t n = 0 ) const;
+		//! Returns the transform of the \a n'th mesh in the node called \a name, the bone matrix of rigid meshes, identity for the others.
+		ci::Matrix44f getAssimpNodeMeshTransform( const std::string &name, size_t n = 0 ) const;
 
 		//! Returns the texture of the \a n'th mesh in the node called \a name.
 		ci::gl::Texture &getAssimpNodeTexture( const std::string &name, size_t n = 0 );
@@ -163,6 +327,15 @@ class AssimpLoader
 		//! Returns the material of the \a n'th mesh in the node called \a name.
 		const ci::gl::Material &getAssimpNodeMaterial( const std::string &name, size_t n = 0 ) const;
 
+		//! Returns the number of joints, which are all nodes of the model in the order of getNodeNames().
+		size_t getNumJoints() const { return mJointNodes.size(); }
+		//! Returns the local joint transforms of the last update(), including the animation.
+		const Pose &getPose() const { return mPose; }
+		//! Returns the model space transform of joint \a n after the last update() with skinning enabled.
+		const ci::Matrix44f &getJointTransform( size_t n ) const { return mJointTransforms[ n ]; }
+		//! Writes the model space transforms of all joints after the last update() with skinning enabled to \a transforms, which has room for getNumJoints() matrices.
+		void getJointTransforms( ci::Matrix44f *transforms ) const;
+
 		//! Returns all node names in the model in a std::vector as std::string's.
 		const std::vector< std::string > &getNodeNames() { return mNodeNames; }
 
@@ -181,6 +354,62 @@ class AssimpLoader
 		//! Disables skinning, when the model's bones distort the vertices.
 		void disableSkinning() { enableSkinning( false ); }
 
+		/** Enables/disables drawing meshes bound to a single bone with the bone's
+		  matrix instead of skinning their vertices. Enabled by default. The
+		  vertices of rigid meshes stay in bind pose, use getMeshTransform() to
+		  place them. */
+		void enableRigidMeshes( bool enable = true );
+		//! Disables the rigid mesh path, all meshes are skinned per vertex.
+		void disableRigidMeshes() { enableRigidMeshes( false ); }
+
+		/** Enables/disables double buffered skinning. update() skins into back
+		  buffers while draw() and getMesh() use the front ones, which are only
+		  changed by swapBuffers(). This lets update() run on another thread
+		  while the last frame is drawn. Baked playback and disabled skinning
+		  still write the front buffers. */
+		void enableDoubleBuffering( bool enable = true );
+		//! Disables double buffered skinning.
+		void disableDoubleBuffering() { enableDoubleBuffering( false ); }
+		bool isDoubleBuffered() const { return mDoubleBuffered; }
+		//! Makes the result of the last update() visible to draw() when double buffering. Must not overlap with update() or draw().
+		void swapBuffers();
+
+		/** Enables/disables skinning in a vertex shader for the meshes with at
+		  most GpuSkinning::MAX_BONES bones. The cpu only updates the matrix
+		  palette, the vertices of these meshes are uploaded once and getMesh()
+		  returns them in bind pose. Needs a current OpenGL context. */
+		void enableGpuSkinning( bool enable = true );
+		//! Disables gpu skinning, all meshes are skinned on the cpu.
+		void disableGpuSkinning() { enableGpuSkinning( false ); }
+		bool isGpuSkinningEnabled() const { return mGpuSkinningEnabled; }
+		/** Returns the largest difference between the gpu and cpu skinned
+		  positions and normals of the current pose, read back via transform
+		  feedback. Call after update() with gpu skinning enabled. Returns -1
+		  if the OpenGL context has no transform feedback to read back with. */
+		float getGpuSkinningError();
+
+		//! Selects the skinning kernel, throws AssimpLoaderExc if the cpu does not support it. Defaults to the fastest one.
+		void setSkinningKernel( SkinningKernel kernel );
+		SkinningKernel getSkinningKernel() const { return mSkinningKernel; }
+
+		//! Skins on \a numThreads threads including the calling one, 1 skins on the calling thread only.
+		void setNumSkinningThreads( size_t numThreads );
+		size_t getNumSkinningThreads() const;
+		//! Skins on the threads of \a pool, which can be shared with other models. Pass an empty ref to skin on the calling thread.
+		void setSkinningThreadPool( ThreadPoolRef pool ) { mSkinningThreadPool = pool; }
+		//! Sets the number of vertices skinned by one job, meshes with more vertices are split.
+		void setSkinningChunkSize( size_t numVertices );
+		size_t getSkinningChunkSize() const { return mSkinningChunkSize; }
+
+		//! Returns the time the skinning of the last update() took in seconds.
+		double getSkinningSeconds() const { return mSkinningSeconds; }
+		//! Returns the number of vertices skinned in the last update(). Only vertices influenced by moved bones are re-skinned.
+		size_t getNumSkinnedVertices() const { return mNumSkinnedVertices; }
+		//! Returns the number of vertices of the \a n'th mesh skinned in the last update().
+		size_t getMeshNumSkinnedVertices( size_t n ) const { return mModelMeshes[ n ]->mNumSkinnedVertices; }
+		//! Returns the number of vertices of the \a n'th mesh without bone weights, which are never skinned.
+		size_t getMeshNumStaticVertices( size_t n ) const { return mModelMeshes[ n ]->mNumStaticVertices; }
+
 		//! Enables/disables animation.
 		void enableAnimation( bool enable = true ) { mAnimationEnabled = enable; }
 		//! Disables animation.
@@ -188,11 +417,17 @@ class AssimpLoader
 
 		//! Returns the total number of meshes in the model.
 		size_t getNumMeshes() const { return mModelMeshes.size(); }
-		//! Returns the \a n'th mesh in the model.
+		/** Returns the \a n'th mesh in the model. While rigid meshes are
+		  enabled, meshes bound to a single bone keep their bind pose vertices,
+		  place them with getMeshTransform() or call disableRigidMeshes() to
+		  have them skinned. */
 		ci::TriMesh &getMesh( size_t n ) { return mModelMeshes[ n ]->mCachedTriMesh; }
-		//! Returns the \a n'th mesh in the model.
+		//! Returns the \a n'th mesh in the model, see above for rigid meshes.
 		const ci::TriMesh &getMesh( size_t n ) const { return mModelMeshes[ n ]->mCachedTriMesh; }
 
+		//! Returns the transform of the \a n'th mesh, the bone matrix of rigid meshes, identity for the others.
+		ci::Matrix44f getMeshTransform( size_t n ) const { return getMeshTransform( mModelMeshes[ n ] ); }
+
 		//! Returns the texture of the \a n'th mesh in the model.
 		ci::gl::Texture &getTexture( size_t n ) { return mModelMeshes[ n ]->mTexture; }
 		//! Returns the texture of the \a n'th mesh in the model.
@@ -210,18 +445,72 @@ class AssimpLoader
 		//! Sets current animation time.
 		void setTime( double t );
 
+		/** Precomputes the skinned vertices of the \a n'th animation. While
+		  animation and skinning are enabled and \a n is the current animation,
+		  update() plays back the baked frames instead of skinning the meshes.
+		  The frames divide the clip evenly, so playback loops with the period
+		  of getAnimationDuration(). Returns false without baking if the frames
+		  would exceed the memory limit of \a format. The frames are stored in
+		  their final format as they are skinned, quantized bakes skin the clip
+		  twice to find the bounds first. */
+		bool bakeAnimation( size_t n, const BakeFormat &format = BakeFormat() );
+		//! Frees the baked frames.
+		void clearBakedAnimation();
+		//! Returns true if animation \a n is baked.
+		bool isAnimationBaked( size_t n ) const { return mBakedAnimation == int( n ); }
+		//! Returns the time the last bakeAnimation() took in seconds.
+		double getBakeSeconds() const { return mBakeSeconds; }
+		//! Returns the memory used by the baked frames in bytes.
+		size_t getBakeNumBytes() const { return mBakeNumBytes; }
+
+		/** Shares sampled animation poses with other models through \a cache.
+		  Sample times are rounded to multiples of \a timeStep seconds. Models
+		  loaded from the same file share their clips. Pass an empty ref to
+		  disable caching. */
+		void setPoseCache( PoseCacheRef cache, double timeStep = 1.0 / 60.0 );
+		//! Returns the pose cache, or an empty ref if caching is disabled.
+		PoseCacheRef getPoseCache() const { return mPoseCache; }
+
+		//! Vertex range of a mesh skinned by one thread.
+		struct SkinningJob
+		{
+			SkinningFunc mFunc;
+			SkinningData mData;
+			size_t mBegin;
+			size_t mEnd;
+		};
+
 	private:
 		void loadAllMeshes();
+		//! Returns true if \a node is a handle of a node of the model.
+		bool isValidNode( int node ) const { return ( node >= 0 ) && ( size_t( node ) < mJointNodes.size() ); }
+
 		AssimpNodeRef loadNodes( const aiNode* nd, AssimpNodeRef parentRef = AssimpNodeRef() );
+		void resolveChannels();
+		void resolveBones();
+		size_t getPaletteIndex( size_t joint, const ci::Matrix44f &offset );
+		void buildInfluences( AssimpMeshRef assimpMeshRef );
+		bool isRigid( const AssimpMeshRef &assimpMeshRef ) const;
+		bool isGpuSkinned( const AssimpMeshRef &assimpMeshRef ) const;
+		ci::Matrix44f getMeshTransform( const AssimpMeshRef &assimpMeshRef ) const;
 		AssimpMeshRef convertAiMesh( const aiMesh *mesh );
 
 		void calculateDimensions();
 		void calculateBoundingBox( ci::Vec3f *min, ci::Vec3f *max );
 		void calculateBoundingBoxForNode( const aiNode *nd, aiVector3D *min, aiVector3D *max, aiMatrix4x4 *trafo );
 
+		void readPose();
 		void updateAnimation( size_t animationIndex, double currentTime );
+		void sampleAnimation( size_t animationIndex, double currentTime, Pose *channelPose ) const;
+		void applyChannelPose( size_t animationIndex );
+		void skinBakedFrame( size_t animationIndex, double time );
+		void updateJointTransforms();
+		void updatePalette();
 		void updateSkinning();
+		void reserveSkinningJobs();
 		void updateMeshes();
+		void updateBakedMeshes( double currentTime );
+		void invalidateMeshes();
 
 		std::shared_ptr< Assimp::Importer > mImporterRef; // mScene will be destroyed along with the Importer object
 		ci::fs::path mFilePath; /// model path
@@ -229,18 +518,72 @@ class AssimpLoader
 
 		ci::AxisAlignedBox3f mBoundingBox;
 
+		AssimpNodePoolRef mNodePool; /// storage of the nodes, shared by the copies of the loader
 		AssimpNodeRef mRootNode; /// root node of scene
 
 		std::vector< AssimpNodeRef > mMeshNodes; /// nodes with meshes
 		std::vector< AssimpMeshRef > mModelMeshes; /// all meshes
-
-		std::vector< std::string > mNodeNames;
-		std::map< std::string, AssimpNodeRef > mNodeMap;
+		std::vector< AssimpMeshRef > mSkinnedMeshes; /// unique meshes of mMeshNodes
+
+		std::vector< std::string > mNodeNames; /// node names indexed by handle
+
+		std::vector< AssimpNodeRef > mJointNodes; /// all nodes indexed by joint, parents first
+		std::unordered_map< std::string, size_t > mNodeIndices; /// handle of each node name
+		std::vector< std::vector< int > > mChannelJoints; /// joint index of each channel per animation, -1 if missing
+
+		Pose mPose; /// local joint transforms, the node values overridden by the animation
+		Pose mDerivedPose; /// joint transforms combined with those of the parents
+		std::vector< ci::Matrix44f > mJointTransforms; /// derived joint transforms as matrices
+
+		Pose mLastPose; /// local joint transforms of the last updateJointTransforms()
+		std::vector< uint8_t > mLastJointFlags; /// inheritance flags of the last updateJointTransforms()
+		std::vector< int > mLastJointParents; /// parent joints of the last updateJointTransforms()
+		size_t mPoseGeneration; /// incremented by every updateJointTransforms()
+		std::vector< size_t > mJointGenerations; /// pose generation of the last change of each joint, 0 if never calculated
+
+		WeightFormat mWeightFormat;
+		size_t mNumPrunedInfluences;
+		float mMaxPruneError;
+
+		std::vector< size_t > mPaletteJoints; /// joint of each palette entry
+		std::vector< ci::Matrix44f > mPaletteOffsets; /// mesh to bone space matrix of each palette entry
+		std::vector< ci::Matrix44f > mPalette; /// skinning matrices shared by the meshes
+		std::vector< ci::Matrix44f > mFrontPalette; /// palette of the front buffers when double buffering
+		std::vector< size_t > mPaletteGenerations; /// pose generation of each palette entry
+		Pose mChannelPose; /// sampled transforms indexed by animation channel
+
+		PoseCacheRef mPoseCache;
+		double mPoseCacheTimeStep;
+		std::vector< size_t > mPoseCacheClipIds; /// clip id of each animation
+
+		int mBakedAnimation; /// index of the baked animation, -1 if none
+		BakeFormat mBakeFormat;
+		size_t mNumBakedFrames;
+		double mBakedDuration; /// clip duration, the period of the baked frames
+		double mBakeSeconds;
+		size_t mBakeNumBytes;
+		bool mBakedPlayback; /// the last update() played back baked frames
+
+		size_t mUpdateInterval;
+		size_t mNumSkippedUpdates;
+		bool mUpdated; /// set by the first update() which was not skipped
+
+		SkinningKernel mSkinningKernel;
+		double mSkinningSeconds;
+		size_t mNumSkinnedVertices;
+
+		ThreadPoolRef mSkinningThreadPool;
+		size_t mSkinningChunkSize;
+		std::vector< SkinningJob > mSkinningJobs;
 
 		bool mMaterialsEnabled;
 		bool mTexturesEnabled;
 		bool mSkinningEnabled;
 		bool mAnimationEnabled;
+		bool mRigidMeshesEnabled;
+		bool mDoubleBuffered;
+		bool mGpuSkinningEnabled;
+		GpuSkinningRef mGpuSkinning;
 
 		size_t mAnimationIndex;
 		double mAnimationTime;
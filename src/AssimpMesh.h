@@ -24,15 +24,36 @@
 //#include "assimp/aiMesh.h"
 
 #include "cinder/Cinder.h"
+#include "cinder/Matrix.h"
 #include "cinder/TriMesh.h"
 #include "cinder/gl/Material.h"
 #include "cinder/gl/Texture.h"
+#include "cinder/gl/Vbo.h"
+
+#include "SkinningKernels.h"
 
 namespace mndl { namespace assimp {
 
 class AssimpMesh;
 typedef std::shared_ptr< AssimpMesh > AssimpMeshRef;
 
+//! Skinned vertices of a mesh baked at regular intervals of an animation.
+class BakedFrames
+{
+	public:
+		//! Frames stored in full precision, mNumVertices per frame.
+		std::vector< ci::Vec3f > mPositions;
+		std::vector< ci::Vec3f > mNormals;
+
+		//! Quantized frames, positions are relative to mOrigin in mStep units.
+		std::vector< uint16_t > mQuantizedPositions;
+		std::vector< int8_t > mQuantizedNormals;
+		ci::Vec3f mOrigin;
+		ci::Vec3f mStep;
+
+		size_t mNumVertices;
+};
+
 class AssimpMesh
 {
 	public:
@@ -45,12 +66,56 @@ class AssimpMesh
 		ci::gl::Material mMaterial;
 		bool mTwoSided;
 
-		std::vector< aiVector3D > mAnimatedPos;
-		std::vector< aiVector3D > mAnimatedNorm;
+		//! Joint index of each bone, resolved at load.
+		std::vector< size_t > mBoneJoints;
+		//! Index of each bone in the skinning matrix palette of the loader.
+		std::vector< size_t > mBonePaletteIndices;
+
+		//! Number of bone influences stored per vertex, 1, 2, 4 or 8.
+		size_t mNumInfluences;
+		//! Skinning kernel specialized for the influences and attributes of the mesh.
+		SkinningFunc mSkinningFunc;
+		/** Palette indices and weights of the vertices, mNumInfluences per vertex,
+		  ordered by decreasing weight and padded with zero weights. */
+		std::vector< uint16_t > mInfluenceBones;
+		std::vector< float > mInfluenceWeights;
+
+		//! Ranges of vertices with bone weights, the others are static.
+		std::vector< std::pair< size_t, size_t > > mSkinnedRanges;
+		size_t mNumStaticVertices;
+		//! Number of vertices skinned in the last update.
+		size_t mNumSkinnedVertices;
+
+		/** Vertex ranges [ first, second ) influenced by each bone, the ranges of
+		  bone a are mBoneRanges[ mBoneRangeOffsets[ a ] .. mBoneRangeOffsets[ a + 1 ] ). */
+		std::vector< size_t > mBoneRangeOffsets;
+		std::vector< std::pair< size_t, size_t > > mBoneRanges;
+		//! Vertex ranges to re-skin, reserved to the size of mBoneRanges or mSkinnedRanges.
+		std::vector< std::pair< size_t, size_t > > mDirtyRanges;
+
+		//! Palette index of the bone moving all vertices rigidly, -1 if the mesh is skinned per vertex.
+		int mRigidPaletteIndex;
+
+		//! Pose generation the mesh was last skinned with.
+		size_t mSkinnedGeneration;
+
+		BakedFrames mBakedFrames;
+
+		//! Interleaved vertices and indices of the gpu skinning, unset if the mesh is skinned on the cpu.
+		ci::gl::Vbo mGpuVertexVbo;
+		ci::gl::Vbo mGpuIndexVbo;
+		//! Matrices of the bones of the mesh sent to the skinning shader.
+		std::vector< ci::Matrix44f > mGpuBoneMatrices;
 
 		std::string mName;
 		ci::TriMesh mCachedTriMesh;
 		bool mValidCache;
+
+		//! Back buffers skinned into when double buffering, swapped with the arrays of mCachedTriMesh.
+		std::vector< ci::Vec3f > mBackVertices;
+		std::vector< ci::Vec3f > mBackNormals;
+		bool mBackValidCache;
+		size_t mBackSkinnedGeneration;
 };
 
 } } // namespace mndl::assimp
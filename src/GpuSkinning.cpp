@@ -0,0 +1,342 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+#include <cstdlib>
+#include <map>
+
+#include "AssimpLoader.h"
+#include "GpuSkinning.h"
+
+using namespace ci;
+using namespace std;
+
+namespace mndl { namespace assimp {
+
+// uBones has GpuSkinning::MAX_BONES elements, vertices without weights
+// have a zero first weight and are not moved
+static const char *sSkinningVertexShader =
+	"#version 120\n"
+	"uniform mat4 uBones[ 60 ];\n"
+	"uniform bool uLighting;\n"
+	"attribute vec4 aBones0;\n"
+	"attribute vec4 aBones1;\n"
+	"attribute vec4 aWeights0;\n"
+	"attribute vec4 aWeights1;\n"
+	"varying vec3 vPosition;\n"
+	"varying vec3 vNormal;\n"
+	"varying vec4 vColor;\n"
+	"void main()\n"
+	"{\n"
+	"	mat4 m = mat4( 1.0 );\n"
+	"	if ( aWeights0.x > 0.0 )\n"
+	"	{\n"
+	"		m = uBones[ int( aBones0.x ) ] * aWeights0.x +\n"
+	"			uBones[ int( aBones0.y ) ] * aWeights0.y +\n"
+	"			uBones[ int( aBones0.z ) ] * aWeights0.z +\n"
+	"			uBones[ int( aBones0.w ) ] * aWeights0.w +\n"
+	"			uBones[ int( aBones1.x ) ] * aWeights1.x +\n"
+	"			uBones[ int( aBones1.y ) ] * aWeights1.y +\n"
+	"			uBones[ int( aBones1.z ) ] * aWeights1.z +\n"
+	"			uBones[ int( aBones1.w ) ] * aWeights1.w;\n"
+	"	}\n"
+	"	vec4 position = m * gl_Vertex;\n"
+	"	vPosition = position.xyz;\n"
+	"	vNormal = mat3( m ) * gl_Normal;\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * position;\n"
+	"	gl_TexCoord[ 0 ] = gl_MultiTexCoord0;\n"
+	"	if ( uLighting )\n"
+	"	{\n"
+	"		vec3 n = normalize( gl_NormalMatrix * vNormal );\n"
+	"		vec3 eyePosition = vec3( gl_ModelViewMatrix * position );\n"
+	"		vec4 lightPosition = gl_LightSource[ 0 ].position;\n"
+	"		vec3 l = normalize( lightPosition.xyz - eyePosition * lightPosition.w );\n"
+	"		vColor = gl_FrontLightModelProduct.sceneColor + gl_FrontLightProduct[ 0 ].ambient +\n"
+	"			gl_FrontLightProduct[ 0 ].diffuse * max( dot( n, l ), 0.0 );\n"
+	"		vColor.a = gl_FrontMaterial.diffuse.a;\n"
+	"	}\n"
+	"	else\n"
+	"	{\n"
+	"		vColor = gl_Color;\n"
+	"	}\n"
+	"}\n";
+
+static const char *sSkinningFragmentShader =
+	"#version 120\n"
+	"uniform sampler2D uTexture;\n"
+	"uniform bool uTextured;\n"
+	"varying vec4 vColor;\n"
+	"void main()\n"
+	"{\n"
+	"	vec4 color = vColor;\n"
+	"	if ( uTextured )\n"
+	"		color *= texture2D( uTexture, gl_TexCoord[ 0 ].st );\n"
+	"	gl_FragColor = color;\n"
+	"}\n";
+
+//! Interleaved vertex of the gpu skinning, the influences are padded to 8.
+struct GpuVertex
+{
+	Vec3f mPosition;
+	Vec3f mNormal;
+	Vec2f mTexCoord;
+	float mBones[ 8 ];
+	float mWeights[ 8 ];
+};
+
+#define MNDL_VERTEX_OFFSET( member, n ) \
+	( reinterpret_cast< const GLvoid * >( offsetof( GpuVertex, member ) + ( n ) * sizeof( float ) ) )
+
+// transform feedback is core from OpenGL 3.0, the legacy OpenGL 2.1 headers
+// of OS X only have the EXT_transform_feedback names
+#if defined( CINDER_MAC )
+#define MNDL_TF_FUNC( name ) name##EXT
+#define MNDL_TF_ENUM( name ) name##_EXT
+#else
+#define MNDL_TF_FUNC( name ) name
+#define MNDL_TF_ENUM( name ) name
+#endif
+
+//! Returns true if the current context can capture vertices with the transform feedback names above.
+static bool isTransformFeedbackAvailable()
+{
+#if defined( CINDER_MAC )
+	return gl::isExtensionAvailable( "GL_EXT_transform_feedback" );
+#else
+	const char *version = reinterpret_cast< const char * >( glGetString( GL_VERSION ) );
+	return ( version != NULL ) && ( atoi( version ) >= 3 );
+#endif
+}
+
+GpuSkinning::GpuSkinning() :
+	mReadBackSupported( false ),
+	mFeedbackBuffer( 0 ),
+	mFeedbackBufferSize( 0 )
+{
+	try
+	{
+		mShader = gl::GlslProg( sSkinningVertexShader, sSkinningFragmentShader );
+	}
+	catch ( const gl::GlslProgCompileExc &exc )
+	{
+		throw AssimpLoaderExc( string( "gpu skinning shader: " ) + exc.what() );
+	}
+
+	// the skinned vertices can be captured by transform feedback if the
+	// context has it, the varyings have to be set up before relinking
+	GLuint program = mShader.getHandle();
+	mReadBackSupported = isTransformFeedbackAvailable();
+	if ( mReadBackSupported )
+	{
+		const char *varyings[] = { "vPosition", "vNormal" };
+		MNDL_TF_FUNC( glTransformFeedbackVaryings )( program, 2, varyings,
+				MNDL_TF_ENUM( GL_INTERLEAVED_ATTRIBS ) );
+		glLinkProgram( program );
+		GLint linked = GL_FALSE;
+		glGetProgramiv( program, GL_LINK_STATUS, &linked );
+		if ( !linked )
+			throw AssimpLoaderExc( "gpu skinning shader: transform feedback link failed." );
+	}
+
+	// relinking invalidates the locations cached by GlslProg, so they are
+	// queried here
+	mBonesLocation = glGetUniformLocation( program, "uBones" );
+	mLightingLocation = glGetUniformLocation( program, "uLighting" );
+	mTexturedLocation = glGetUniformLocation( program, "uTextured" );
+	mTextureLocation = glGetUniformLocation( program, "uTexture" );
+	mBoneAttribs[ 0 ] = glGetAttribLocation( program, "aBones0" );
+	mBoneAttribs[ 1 ] = glGetAttribLocation( program, "aBones1" );
+	mWeightAttribs[ 0 ] = glGetAttribLocation( program, "aWeights0" );
+	mWeightAttribs[ 1 ] = glGetAttribLocation( program, "aWeights1" );
+}
+
+GpuSkinning::~GpuSkinning()
+{
+	if ( mFeedbackBuffer )
+		glDeleteBuffers( 1, &mFeedbackBuffer );
+}
+
+bool GpuSkinning::isSupported( const AssimpMeshRef &assimpMeshRef )
+{
+	size_t numBones = assimpMeshRef->mBoneJoints.size();
+	return ( numBones > 0 ) && ( numBones <= MAX_BONES );
+}
+
+void GpuSkinning::setup( const AssimpMeshRef &assimpMeshRef )
+{
+	const aiMesh *mesh = assimpMeshRef->mAiMesh;
+
+	// the influences index the palette, the shader gets the bones of the mesh only
+	map< size_t, size_t > paletteBones;
+	for ( size_t a = 0; a < assimpMeshRef->mBonePaletteIndices.size(); ++a )
+		paletteBones[ assimpMeshRef->mBonePaletteIndices[ a ] ] = a;
+
+	const size_t numInfluences = assimpMeshRef->mNumInfluences;
+	vector< GpuVertex > vertices( mesh->mNumVertices );
+	for ( size_t v = 0; v < vertices.size(); ++v )
+	{
+		GpuVertex &vertex = vertices[ v ];
+		vertex.mPosition = fromAssimp( mesh->mVertices[ v ] );
+		vertex.mNormal = mesh->HasNormals() ? fromAssimp( mesh->mNormals[ v ] ) : Vec3f::zero();
+		if ( mesh->GetNumUVChannels() > 0 )
+			vertex.mTexCoord = Vec2f( mesh->mTextureCoords[ 0 ][ v ].x, mesh->mTextureCoords[ 0 ][ v ].y );
+		else
+			vertex.mTexCoord = Vec2f( 0.0f, 0.0f );
+
+		for ( size_t i = 0; i < 8; ++i )
+		{
+			if ( i < numInfluences )
+			{
+				vertex.mBones[ i ] = float( paletteBones[ assimpMeshRef->mInfluenceBones[ v * numInfluences + i ] ] );
+				vertex.mWeights[ i ] = assimpMeshRef->mInfluenceWeights[ v * numInfluences + i ];
+			}
+			else
+			{
+				vertex.mBones[ i ] = 0.0f;
+				vertex.mWeights[ i ] = 0.0f;
+			}
+		}
+	}
+
+	assimpMeshRef->mGpuVertexVbo = gl::Vbo( GL_ARRAY_BUFFER );
+	assimpMeshRef->mGpuVertexVbo.bufferData( vertices.size() * sizeof( GpuVertex ),
+			vertices.empty() ? NULL : &vertices[ 0 ], GL_STATIC_DRAW );
+	assimpMeshRef->mGpuVertexVbo.unbind();
+
+	const vector< uint32_t > &indices = assimpMeshRef->mIndices;
+	assimpMeshRef->mGpuIndexVbo = gl::Vbo( GL_ELEMENT_ARRAY_BUFFER );
+	assimpMeshRef->mGpuIndexVbo.bufferData( indices.size() * sizeof( uint32_t ),
+			indices.empty() ? NULL : &indices[ 0 ], GL_STATIC_DRAW );
+	assimpMeshRef->mGpuIndexVbo.unbind();
+
+	assimpMeshRef->mGpuBoneMatrices.resize( assimpMeshRef->mBonePaletteIndices.size() );
+}
+
+void GpuSkinning::bindMesh( const AssimpMeshRef &assimpMeshRef, const vector< Matrix44f > &palette )
+{
+	// only the matrices of the bones are sent each frame
+	vector< Matrix44f > &boneMatrices = assimpMeshRef->mGpuBoneMatrices;
+	for ( size_t a = 0; a < boneMatrices.size(); ++a )
+		boneMatrices[ a ] = palette[ assimpMeshRef->mBonePaletteIndices[ a ] ];
+
+	mShader.bind();
+	glUniformMatrix4fv( mBonesLocation, GLsizei( boneMatrices.size() ), GL_FALSE, boneMatrices[ 0 ].m );
+
+	assimpMeshRef->mGpuVertexVbo.bind();
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, sizeof( GpuVertex ), MNDL_VERTEX_OFFSET( mPosition, 0 ) );
+	glEnableClientState( GL_NORMAL_ARRAY );
+	glNormalPointer( GL_FLOAT, sizeof( GpuVertex ), MNDL_VERTEX_OFFSET( mNormal, 0 ) );
+	glClientActiveTexture( GL_TEXTURE0 );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glTexCoordPointer( 2, GL_FLOAT, sizeof( GpuVertex ), MNDL_VERTEX_OFFSET( mTexCoord, 0 ) );
+	for ( int i = 0; i < 2; ++i )
+	{
+		glEnableVertexAttribArray( mBoneAttribs[ i ] );
+		glVertexAttribPointer( mBoneAttribs[ i ], 4, GL_FLOAT, GL_FALSE, sizeof( GpuVertex ),
+				MNDL_VERTEX_OFFSET( mBones, i * 4 ) );
+		glEnableVertexAttribArray( mWeightAttribs[ i ] );
+		glVertexAttribPointer( mWeightAttribs[ i ], 4, GL_FLOAT, GL_FALSE, sizeof( GpuVertex ),
+				MNDL_VERTEX_OFFSET( mWeights, i * 4 ) );
+	}
+}
+
+void GpuSkinning::unbindMesh()
+{
+	for ( int i = 0; i < 2; ++i )
+	{
+		glDisableVertexAttribArray( mBoneAttribs[ i ] );
+		glDisableVertexAttribArray( mWeightAttribs[ i ] );
+	}
+	glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+	glDisableClientState( GL_NORMAL_ARRAY );
+	glDisableClientState( GL_VERTEX_ARRAY );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	mShader.unbind();
+}
+
+void GpuSkinning::draw( const AssimpMeshRef &assimpMeshRef, const vector< Matrix44f > &palette,
+		bool textured )
+{
+	bindMesh( assimpMeshRef, palette );
+
+	glUniform1i( mLightingLocation, glIsEnabled( GL_LIGHTING ) );
+	glUniform1i( mTexturedLocation, textured );
+	glUniform1i( mTextureLocation, 0 );
+
+	assimpMeshRef->mGpuIndexVbo.bind();
+	glDrawElements( GL_TRIANGLES, GLsizei( assimpMeshRef->mIndices.size() ), GL_UNSIGNED_INT, 0 );
+	assimpMeshRef->mGpuIndexVbo.unbind();
+
+	unbindMesh();
+}
+
+bool GpuSkinning::readBack( const AssimpMeshRef &assimpMeshRef, const vector< Matrix44f > &palette,
+		vector< Vec3f > *positions, vector< Vec3f > *normals )
+{
+	if ( !mReadBackSupported )
+		return false;
+
+	const size_t numVertices = assimpMeshRef->mAiMesh->mNumVertices;
+	const size_t numBytes = numVertices * 2 * sizeof( Vec3f );
+	if ( !mFeedbackBuffer )
+		glGenBuffers( 1, &mFeedbackBuffer );
+	glBindBuffer( MNDL_TF_ENUM( GL_TRANSFORM_FEEDBACK_BUFFER ), mFeedbackBuffer );
+	if ( numBytes > mFeedbackBufferSize )
+	{
+		glBufferData( MNDL_TF_ENUM( GL_TRANSFORM_FEEDBACK_BUFFER ), numBytes, NULL, GL_STREAM_READ );
+		mFeedbackBufferSize = numBytes;
+	}
+
+	bindMesh( assimpMeshRef, palette );
+	glUniform1i( mLightingLocation, GL_FALSE );
+	glUniform1i( mTexturedLocation, GL_FALSE );
+
+	// every vertex once as a point, nothing is rasterized
+	MNDL_TF_FUNC( glBindBufferBase )( MNDL_TF_ENUM( GL_TRANSFORM_FEEDBACK_BUFFER ), 0, mFeedbackBuffer );
+	glEnable( MNDL_TF_ENUM( GL_RASTERIZER_DISCARD ) );
+	MNDL_TF_FUNC( glBeginTransformFeedback )( GL_POINTS );
+	glDrawArrays( GL_POINTS, 0, GLsizei( numVertices ) );
+	MNDL_TF_FUNC( glEndTransformFeedback )();
+	glDisable( MNDL_TF_ENUM( GL_RASTERIZER_DISCARD ) );
+	MNDL_TF_FUNC( glBindBufferBase )( MNDL_TF_ENUM( GL_TRANSFORM_FEEDBACK_BUFFER ), 0, 0 );
+
+	unbindMesh();
+
+	// unbinding the indexed binding point has unbound the generic one too
+	vector< Vec3f > feedback( numVertices * 2 );
+	glBindBuffer( MNDL_TF_ENUM( GL_TRANSFORM_FEEDBACK_BUFFER ), mFeedbackBuffer );
+	if ( numVertices > 0 )
+		glGetBufferSubData( MNDL_TF_ENUM( GL_TRANSFORM_FEEDBACK_BUFFER ), 0, numBytes, &feedback[ 0 ] );
+	glBindBuffer( MNDL_TF_ENUM( GL_TRANSFORM_FEEDBACK_BUFFER ), 0 );
+
+	positions->resize( numVertices );
+	normals->resize( numVertices );
+	for ( size_t v = 0; v < numVertices; ++v )
+	{
+		( *positions )[ v ] = feedback[ v * 2 ];
+		( *normals )[ v ] = feedback[ v * 2 + 1 ];
+	}
+	return true;
+}
+
+#undef MNDL_TF_ENUM
+#undef MNDL_TF_FUNC
+#undef MNDL_VERTEX_OFFSET
+
+} } // namespace mndl::assimp
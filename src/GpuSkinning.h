@@ -0,0 +1,94 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "cinder/Cinder.h"
+#include "cinder/Vector.h"
+#include "cinder/Matrix.h"
+#include "cinder/gl/gl.h"
+#include "cinder/gl/GlslProg.h"
+
+#include "AssimpMesh.h"
+
+namespace mndl { namespace assimp {
+
+class GpuSkinning;
+
+typedef std::shared_ptr< GpuSkinning > GpuSkinningRef;
+
+/** Skins meshes in a vertex shader.
+  The vertices, bone indices and weights of a mesh are uploaded once by
+  setup(), afterwards only the matrices of its bones are sent when it is
+  drawn. The shader lights the vertices with light 0 and the current
+  material like the fixed function pipeline does. Needs a current OpenGL
+  context, readBack() also needs transform feedback, OpenGL 3.0 or the
+  EXT_transform_feedback extension on OS X.
+  */
+class GpuSkinning
+{
+	public:
+		//! Maximum number of bones of a mesh skinned on the gpu.
+		static const size_t MAX_BONES = 60;
+
+		//! Compiles the skinning shader, throws AssimpLoaderExc on failure.
+		GpuSkinning();
+		~GpuSkinning();
+
+		//! Returns true if \a assimpMeshRef has bones and no more than MAX_BONES of them.
+		static bool isSupported( const AssimpMeshRef &assimpMeshRef );
+
+		//! Uploads the vertices, bone indices and weights of \a assimpMeshRef.
+		void setup( const AssimpMeshRef &assimpMeshRef );
+
+		//! Draws \a assimpMeshRef skinned with the matrices of \a palette.
+		void draw( const AssimpMeshRef &assimpMeshRef, const std::vector< ci::Matrix44f > &palette,
+				bool textured );
+
+		/** Skins \a assimpMeshRef with \a palette on the gpu and reads the model
+		  space positions and normals back via transform feedback, to validate
+		  the shader against the cpu kernels. Returns false if the context has
+		  no transform feedback. */
+		bool readBack( const AssimpMeshRef &assimpMeshRef, const std::vector< ci::Matrix44f > &palette,
+				std::vector< ci::Vec3f > *positions, std::vector< ci::Vec3f > *normals );
+		//! Returns true if the context has transform feedback for readBack().
+		bool isReadBackSupported() const { return mReadBackSupported; }
+
+	private:
+		GpuSkinning( const GpuSkinning & );
+		GpuSkinning &operator=( const GpuSkinning & );
+
+		void bindMesh( const AssimpMeshRef &assimpMeshRef, const std::vector< ci::Matrix44f > &palette );
+		void unbindMesh();
+
+		ci::gl::GlslProg mShader;
+
+		GLint mBonesLocation;
+		GLint mLightingLocation;
+		GLint mTexturedLocation;
+		GLint mTextureLocation;
+		GLint mBoneAttribs[ 2 ];
+		GLint mWeightAttribs[ 2 ];
+
+		bool mReadBackSupported;
+		GLuint mFeedbackBuffer;
+		size_t mFeedbackBufferSize;
+};
+
+} } // namespace mndl::assimp
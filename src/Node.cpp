@@ -23,31 +23,68 @@ using namespace std;
 namespace mndl {
 
 Node::Node() :
-	mScale( Vec3f::one() ),
-	mInheritOrientation( true ),
-	mInheritScale( true ),
-	mNeedsUpdate( true )
+	mHierarchy( new NodeHierarchy() ),
+	mIndex( mHierarchy->addNode() )
 {
 }
 
 Node::Node( const std::string &name ) :
-	mName( name ),
-	mScale( Vec3f::one() ),
-	mInheritOrientation( true ),
-	mInheritScale( true ),
-	mNeedsUpdate( true )
+	mHierarchy( new NodeHierarchy() ),
+	mIndex( mHierarchy->addNode() ),
+	mName( name )
+{
+}
+
+Node::Node( const NodeHierarchyRef &hierarchy ) :
+	mHierarchy( hierarchy ),
+	mIndex( mHierarchy->addNode() )
 {
 }
 
 void Node::setParent( NodeRef parent )
 {
 	mParent = parent;
-	requestUpdate();
+
+	if ( !parent )
+		mHierarchy->setParent( mIndex, -1 );
+	else if ( ( parent->mHierarchy == mHierarchy ) && ( parent->mIndex < mIndex ) )
+		mHierarchy->setParent( mIndex, int( parent->mIndex ) );
+	else
+		moveTo( parent->mHierarchy, int( parent->mIndex ) );
+}
+
+void Node::moveTo( const NodeHierarchyRef &hierarchy, int parent )
+{
+	// copy before adding the new entry, which might reallocate the arrays
+	Quatf orientation = getOrientation();
+	Vec3f position = getPosition();
+	Vec3f scale = getScale();
+	bool inheritOrientation = getInheritOrientation();
+	bool inheritScale = getInheritScale();
+
+	size_t index = hierarchy->addNode( parent );
+	hierarchy->setOrientation( index, orientation );
+	hierarchy->setPosition( index, position );
+	hierarchy->setScale( index, scale );
+	hierarchy->setInheritOrientation( index, inheritOrientation );
+	hierarchy->setInheritScale( index, inheritScale );
+
+	mHierarchy->removeNode( mIndex );
+	mHierarchy = hierarchy;
+	mIndex = index;
+
+	// parents have to precede their children, so the subtree follows
+	for ( vector< NodeRef >::iterator it = mChildren.begin();
+			it != mChildren.end(); ++it )
+	{
+		if ( (*it)->mParent.lock().get() == this )
+			(*it)->moveTo( hierarchy, int( index ) );
+	}
 }
 
 NodeRef Node::getParent() const
 {
-	return mParent;
+	return mParent.lock();
 }
 
 void Node::addChild( NodeRef child )
@@ -55,60 +92,59 @@ void Node::addChild( NodeRef child )
 	mChildren.push_back( child );
 }
 
+void Node::removeChildren()
+{
+	mChildren.clear();
+}
+
 void Node::setOrientation( const ci::Quatf &q )
 {
-	mOrientation = q;
-	mOrientation.normalize();
-	requestUpdate();
+	mHierarchy->setOrientation( mIndex, q );
 }
 
 const Quatf &Node::getOrientation() const
 {
-	return mOrientation;
+	return mHierarchy->getOrientation( mIndex );
 }
 
 void Node::setPosition( const ci::Vec3f &pos )
 {
-	mPosition = pos;
-	requestUpdate();
+	mHierarchy->setPosition( mIndex, pos );
 }
 
 const Vec3f& Node::getPosition() const
 {
-	return mPosition;
+	return mHierarchy->getPosition( mIndex );
 }
 
 void Node::setScale( const Vec3f &scale )
 {
-	mScale = scale;
-	requestUpdate();
+	mHierarchy->setScale( mIndex, scale );
 }
 
 const Vec3f &Node::getScale() const
 {
-	return mScale;
+	return mHierarchy->getScale( mIndex );
 }
 
 void Node::setInheritOrientation( bool inherit )
 {
-	mInheritOrientation = inherit;
-	requestUpdate();
+	mHierarchy->setInheritOrientation( mIndex, inherit );
 }
 
 bool Node::getInheritOrientation() const
 {
-	return mInheritOrientation;
+	return mHierarchy->getInheritOrientation( mIndex );
 }
 
 void Node::setInheritScale( bool inherit )
 {
-	mInheritScale = inherit;
-	requestUpdate();
+	mHierarchy->setInheritScale( mIndex, inherit );
 }
 
 bool Node::getInheritScale() const
 {
-	return mInheritScale;
+	return mHierarchy->getInheritScale( mIndex );
 }
 
 void Node::setName( const string &name )
@@ -123,17 +159,16 @@ const string &Node::getName() const
 
 void Node::setInitialState()
 {
-	mInitialPosition = mPosition;
-	mInitialOrientation = mOrientation;
-	mInitialScale = mScale;
+	mInitialPosition = getPosition();
+	mInitialOrientation = getOrientation();
+	mInitialScale = getScale();
 }
 
 void Node::resetToInitialState()
 {
-	mPosition = mInitialPosition;
-	mOrientation = mInitialOrientation;
-	mScale = mInitialScale;
-	requestUpdate();
+	setPosition( mInitialPosition );
+	setOrientation( mInitialOrientation );
+	setScale( mInitialScale );
 }
 
 const Vec3f &Node::getInitialPosition() const
@@ -153,90 +188,27 @@ const Vec3f &Node::getInitialScale() const
 
 const Quatf &Node::getDerivedOrientation() const
 {
-	if ( mNeedsUpdate )
-		update();
-	return mDerivedOrientation;
+	return mHierarchy->getDerivedOrientation( mIndex );
 }
 
 const Vec3f &Node::getDerivedPosition() const
 {
-	if ( mNeedsUpdate )
-		update();
-	return mDerivedPosition;
+	return mHierarchy->getDerivedPosition( mIndex );
 }
 
 const Vec3f &Node::getDerivedScale() const
 {
-	if ( mNeedsUpdate )
-		update();
-	return mDerivedScale;
+	return mHierarchy->getDerivedScale( mIndex );
 }
 
 const Matrix44f &Node::getDerivedTransform() const
 {
-	if ( mNeedsUpdate )
-		update();
-
-    mDerivedTransform = Matrix44f::createScale( mDerivedScale );
-    mDerivedTransform *= mDerivedOrientation.toMatrix44();
-    mDerivedTransform.setTranslate( mDerivedPosition );
-
-    return mDerivedTransform;
-}
-
-void Node::update() const
-{
-    if ( mParent )
-    {
-        // update orientation
-        const Quatf &parentOrientation = mParent->getDerivedOrientation();
-        if ( mInheritOrientation )
-        {
-            // Combine orientation with that of parent
-            mDerivedOrientation = getOrientation() * parentOrientation;
-        }
-        else
-        {
-            mDerivedOrientation = getOrientation();
-        }
-
-        // update scale
-        const Vec3f &parentScale = mParent->getDerivedScale();
-        if ( mInheritScale )
-        {
-            mDerivedScale = parentScale * getScale();
-        }
-        else
-        {
-            mDerivedScale = getScale();
-        }
-
-		// change position vector based on parent's orientation & scale
-        mDerivedPosition = ( parentScale * getPosition() ) * parentOrientation;
-
-        // add altered position vector to parent's
-        mDerivedPosition += mParent->getDerivedPosition();
-    }
-    else
-    {
-        // root node, no parent
-        mDerivedOrientation = getOrientation();
-        mDerivedPosition = getPosition();
-        mDerivedScale = getScale();
-    }
-
-	mNeedsUpdate = false;
+	return mHierarchy->getDerivedTransform( mIndex );
 }
 
 void Node::requestUpdate()
 {
-	mNeedsUpdate = true;
-
-	for ( vector< NodeRef >::iterator it = mChildren.begin();
-			it != mChildren.end(); ++it )
-	{
-		(*it)->requestUpdate();
-	}
+	mHierarchy->requestUpdate( mIndex );
 }
 
 } // namespace mndl
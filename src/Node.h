@@ -25,23 +25,41 @@
 #include "cinder/Quaternion.h"
 #include "cinder/Matrix.h"
 
+#include "NodeHierarchy.h"
+
 namespace mndl {
 
 class Node;
 
 typedef std::shared_ptr< Node > NodeRef;
 
+/** Node of a transform hierarchy.
+  The transforms are stored in a NodeHierarchy, the node only refers to its
+  entry. A new node is the root of a hierarchy of its own, setParent() moves
+  it and its children to the hierarchy of the parent if needed. Parents own
+  their children, the link to the parent is weak, so a tree is freed with
+  its root.
+  */
 class Node
 {
 	public:
 		Node();
 		Node( const std::string &name );
+		//! Creates a root node in \a hierarchy.
+		explicit Node( const NodeHierarchyRef &hierarchy );
 		virtual ~Node() {};
 
-		void setParent( NodeRef parent );
+		//! Returns the hierarchy storing the transforms of the node.
+		const NodeHierarchyRef &getHierarchy() const { return mHierarchy; }
+		//! Returns the index of the node in its hierarchy.
+		size_t getIndex() const { return mIndex; }
+
+		virtual void setParent( NodeRef parent );
 		NodeRef getParent() const;
 
 		void addChild( NodeRef child );
+		//! Removes all children, their parent is left unchanged.
+		void removeChildren();
 
 		void setOrientation( const ci::Quatf &q );
 		const ci::Quatf &getOrientation() const;
@@ -76,8 +94,14 @@ class Node
 		void requestUpdate();
 
 	protected:
-		/// Shared pointer to parent node.
-		NodeRef mParent;
+		/// Hierarchy holding the transforms of this node.
+		NodeHierarchyRef mHierarchy;
+
+		/// Index of this node in mHierarchy.
+		size_t mIndex;
+
+		/// Weak pointer to parent node, the parent owns its children.
+		std::weak_ptr< Node > mParent;
 
 		/// Shared pointer vector holding the children.
 		std::vector< NodeRef > mChildren;
@@ -85,41 +109,6 @@ class Node
 		/// Name of this node.
 		std::string mName;
 
-		/// The orientation of the node relative to its parent.
-		ci::Quatf mOrientation;
-
-		/// The position of the node relative to its parent.
-		ci::Vec3f mPosition;
-
-		/// Scaling factor applied to this node.
-		ci::Vec3f mScale;
-
-		/// Stores whether this node inherits orientation from its parent.
-		bool mInheritOrientation;
-
-		mutable bool mNeedsUpdate;
-
-		/// Stores whether this node inherits scale from its parent
-		bool mInheritScale;
-
-		/** Cached combined orientation.
-		  This member is the orientation derived by combining the
-		  local transformations and those of it's parents.
-		  */
-		mutable ci::Quatf mDerivedOrientation;
-
-		/** Cached combined position.
-		  This member is the position derived by combining the
-		  local transformations and those of it's parents.
-		  */
-		mutable ci::Vec3f mDerivedPosition;
-
-		/** Cached combined scale.
-		  This member is the position derived by combining the
-		  local transformations and those of it's parents.
-		  */
-		mutable ci::Vec3f mDerivedScale;
-
 		/// The position to use as a base for keyframe animation.
 		ci::Vec3f mInitialPosition;
 		/// The orientation to use as a base for keyframe animation.
@@ -127,10 +116,10 @@ class Node
 		/// The scale to use as a base for keyframe animation.
 		ci::Vec3f mInitialScale;
 
-		/// Cached derived transform as a 4x4 matrix
-		mutable ci::Matrix44f mDerivedTransform;
-
-		void update() const;
+		/** Adds this node below \a parent in \a hierarchy, followed by its
+		  children. The old entries are released for reuse by later nodes.
+		  */
+		void moveTo( const NodeHierarchyRef &hierarchy, int parent );
 };
 
 } // namespace mndl
@@ -0,0 +1,217 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+
+#include "NodeHierarchy.h"
+
+using namespace ci;
+using namespace std;
+
+namespace mndl {
+
+NodeHierarchy::NodeHierarchy() :
+	mGeneration( 0 ),
+	mFirstDirty( 0 )
+{
+}
+
+size_t NodeHierarchy::addNode( int parent /* = -1 */ )
+{
+	assert( parent < int( mParents.size() ) );
+
+	// a removed entry can be reused if it still follows the parent
+	set< size_t >::iterator freeIt = ( parent < 0 ) ? mFreeNodes.begin() :
+		mFreeNodes.upper_bound( size_t( parent ) );
+	if ( freeIt != mFreeNodes.end() )
+	{
+		size_t node = *freeIt;
+		mFreeNodes.erase( freeIt );
+
+		mParents[ node ] = parent;
+		mFlags[ node ] = INHERIT_ORIENTATION | INHERIT_SCALE;
+		mLocalPose.mPositions[ node ] = Vec3f::zero();
+		mLocalPose.mOrientations[ node ] = Quatf();
+		mLocalPose.mScales[ node ] = Vec3f::one();
+		requestUpdate( node );
+		return node;
+	}
+
+	mParents.push_back( parent );
+	mFlags.push_back( INHERIT_ORIENTATION | INHERIT_SCALE );
+	mLocalPose.mPositions.push_back( Vec3f::zero() );
+	mLocalPose.mOrientations.push_back( Quatf() );
+	mLocalPose.mScales.push_back( Vec3f::one() );
+	mDerivedPose.mPositions.push_back( Vec3f::zero() );
+	mDerivedPose.mOrientations.push_back( Quatf() );
+	mDerivedPose.mScales.push_back( Vec3f::one() );
+	mDerivedTransforms.push_back( Matrix44f() );
+	mTransformGenerations.push_back( 0 );
+	mDirty.push_back( 1 );
+	mDerivedGenerations.push_back( 0 );
+
+	size_t node = mParents.size() - 1;
+	requestUpdate( node );
+	return node;
+}
+
+void NodeHierarchy::removeNode( size_t node )
+{
+	assert( node < mParents.size() );
+
+	// removed entries are clean roots, skipped by update()
+	mParents[ node ] = -1;
+	mDirty[ node ] = 0;
+	mFreeNodes.insert( node );
+}
+
+void NodeHierarchy::setParent( size_t node, int parent )
+{
+	assert( parent < int( node ) );
+
+	mParents[ node ] = parent;
+	requestUpdate( node );
+}
+
+void NodeHierarchy::setOrientation( size_t node, const Quatf &q )
+{
+	Quatf &orientation = mLocalPose.mOrientations[ node ];
+	orientation = q;
+	orientation.normalize();
+	requestUpdate( node );
+}
+
+void NodeHierarchy::setPosition( size_t node, const Vec3f &pos )
+{
+	mLocalPose.mPositions[ node ] = pos;
+	requestUpdate( node );
+}
+
+void NodeHierarchy::setScale( size_t node, const Vec3f &scale )
+{
+	mLocalPose.mScales[ node ] = scale;
+	requestUpdate( node );
+}
+
+void NodeHierarchy::setInheritOrientation( size_t node, bool inherit )
+{
+	if ( inherit )
+		mFlags[ node ] |= INHERIT_ORIENTATION;
+	else
+		mFlags[ node ] &= ~INHERIT_ORIENTATION;
+	requestUpdate( node );
+}
+
+void NodeHierarchy::setInheritScale( size_t node, bool inherit )
+{
+	if ( inherit )
+		mFlags[ node ] |= INHERIT_SCALE;
+	else
+		mFlags[ node ] &= ~INHERIT_SCALE;
+	requestUpdate( node );
+}
+
+const Pose &NodeHierarchy::getDerivedPose() const
+{
+	if ( mFirstDirty < mParents.size() )
+		update();
+	return mDerivedPose;
+}
+
+const Matrix44f &NodeHierarchy::getDerivedTransform( size_t node ) const
+{
+	if ( mFirstDirty <= node )
+		update();
+
+	// derived generations start from 1, so a new matrix is always built
+	Matrix44f &transform = mDerivedTransforms[ node ];
+	if ( mTransformGenerations[ node ] != mDerivedGenerations[ node ] )
+	{
+		transform = Matrix44f::createScale( mDerivedPose.mScales[ node ] );
+		transform *= mDerivedPose.mOrientations[ node ].toMatrix44();
+		transform.setTranslate( mDerivedPose.mPositions[ node ] );
+		mTransformGenerations[ node ] = mDerivedGenerations[ node ];
+	}
+	return transform;
+}
+
+void NodeHierarchy::getDerivedTransforms( Matrix44f *transforms ) const
+{
+	for ( size_t i = 0; i < mParents.size(); ++i )
+		transforms[ i ] = getDerivedTransform( i );
+}
+
+void NodeHierarchy::update() const
+{
+	mGeneration++;
+
+	// parents precede their children, so their derived transforms are ready
+	// and a recalculated parent is known by its generation
+	for ( size_t i = mFirstDirty; i < mParents.size(); ++i )
+	{
+		int parent = mParents[ i ];
+		if ( !mDirty[ i ] &&
+			 ( ( parent < 0 ) || ( mDerivedGenerations[ parent ] != mGeneration ) ) )
+			continue;
+
+		mDirty[ i ] = 0;
+		mDerivedGenerations[ i ] = mGeneration;
+		deriveNode( mLocalPose, i, parent, mFlags[ i ], &mDerivedPose );
+	}
+
+	mFirstDirty = mParents.size();
+}
+
+void NodeHierarchy::deriveNode( const Pose &localPose, size_t node, int parent, uint8_t flags,
+		Pose *derivedPose )
+{
+	const Quatf &orientation = localPose.mOrientations[ node ];
+	const Vec3f &position = localPose.mPositions[ node ];
+	const Vec3f &scale = localPose.mScales[ node ];
+
+	Quatf &derivedOrientation = derivedPose->mOrientations[ node ];
+	Vec3f &derivedPosition = derivedPose->mPositions[ node ];
+	Vec3f &derivedScale = derivedPose->mScales[ node ];
+
+	if ( parent >= 0 )
+	{
+		const Quatf &parentOrientation = derivedPose->mOrientations[ parent ];
+		const Vec3f &parentScale = derivedPose->mScales[ parent ];
+
+		if ( flags & INHERIT_ORIENTATION )
+			derivedOrientation = orientation * parentOrientation;
+		else
+			derivedOrientation = orientation;
+
+		if ( flags & INHERIT_SCALE )
+			derivedScale = parentScale * scale;
+		else
+			derivedScale = scale;
+
+		// change position vector based on parent's orientation & scale
+		derivedPosition = ( parentScale * position ) * parentOrientation;
+		derivedPosition += derivedPose->mPositions[ parent ];
+	}
+	else
+	{
+		derivedOrientation = orientation;
+		derivedPosition = position;
+		derivedScale = scale;
+	}
+}
+
+} // namespace mndl
@@ -0,0 +1,143 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <set>
+#include <vector>
+
+#include "cinder/Cinder.h"
+#include "cinder/Vector.h"
+#include "cinder/Quaternion.h"
+#include "cinder/Matrix.h"
+
+#include "Pose.h"
+
+namespace mndl {
+
+class NodeHierarchy;
+
+typedef std::shared_ptr< NodeHierarchy > NodeHierarchyRef;
+
+/** Transform hierarchy stored in flat arrays indexed by node.
+  Parents always precede their children, so the derived transforms of all
+  nodes are calculated in one linear pass. Changing a node only flags the
+  node itself, the pass starts at the first flagged node and recalculates
+  the flagged nodes and the nodes whose parent was recalculated in the same
+  pass. Node objects are views of an entry of a hierarchy.
+  */
+class NodeHierarchy
+{
+	public:
+		//! Inheritance flags of a node.
+		enum
+		{
+			INHERIT_ORIENTATION = 1,
+			INHERIT_SCALE = 2
+		};
+
+		NodeHierarchy();
+
+		/** Adds a node below \a parent, or a root if \a parent is -1. Reuses the
+		  first removed entry after \a parent, or appends a new one. Returns the
+		  index of the new node. */
+		size_t addNode( int parent = -1 );
+		//! Releases the entry of \a node for reuse by addNode(). \a node must not have children.
+		void removeNode( size_t node );
+
+		//! Returns the number of entries, removed ones included.
+		size_t getNumNodes() const { return mParents.size(); }
+		//! Returns the number of removed entries waiting for reuse.
+		size_t getNumFreeNodes() const { return mFreeNodes.size(); }
+
+		//! Sets the parent of \a node. \a parent has to precede \a node, or be -1 to make \a node a root.
+		void setParent( size_t node, int parent );
+		int getParent( size_t node ) const { return mParents[ node ]; }
+
+		void setOrientation( size_t node, const ci::Quatf &q );
+		const ci::Quatf &getOrientation( size_t node ) const { return mLocalPose.mOrientations[ node ]; }
+
+		void setPosition( size_t node, const ci::Vec3f &pos );
+		const ci::Vec3f &getPosition( size_t node ) const { return mLocalPose.mPositions[ node ]; }
+
+		void setScale( size_t node, const ci::Vec3f &scale );
+		const ci::Vec3f &getScale( size_t node ) const { return mLocalPose.mScales[ node ]; }
+
+		void setInheritOrientation( size_t node, bool inherit );
+		bool getInheritOrientation( size_t node ) const { return ( mFlags[ node ] & INHERIT_ORIENTATION ) != 0; }
+
+		void setInheritScale( size_t node, bool inherit );
+		bool getInheritScale( size_t node ) const { return ( mFlags[ node ] & INHERIT_SCALE ) != 0; }
+
+		const ci::Quatf &getDerivedOrientation( size_t node ) const { return getDerivedPose().mOrientations[ node ]; }
+		const ci::Vec3f &getDerivedPosition( size_t node ) const { return getDerivedPose().mPositions[ node ]; }
+		const ci::Vec3f &getDerivedScale( size_t node ) const { return getDerivedPose().mScales[ node ]; }
+
+		/** Returns the derived transform of \a node as a matrix. The matrix is
+		  cached until the derived transform of the node changes. */
+		const ci::Matrix44f &getDerivedTransform( size_t node ) const;
+		//! Writes the derived transform matrices of all nodes to \a transforms, which has room for getNumNodes() matrices.
+		void getDerivedTransforms( ci::Matrix44f *transforms ) const;
+
+		//! Returns the local transforms of all nodes.
+		const Pose &getLocalPose() const { return mLocalPose; }
+		//! Returns the inheritance flags of all nodes.
+		const std::vector< uint8_t > &getFlags() const { return mFlags; }
+		//! Returns the derived transforms of all nodes, updated if needed.
+		const Pose &getDerivedPose() const;
+
+		//! Marks the derived transforms of \a node and its descendants out of date.
+		void requestUpdate( size_t node )
+		{
+			mDirty[ node ] = 1;
+			if ( node < mFirstDirty )
+				mFirstDirty = node;
+		}
+
+		//! Calculates the derived transforms of the nodes marked out of date and their descendants.
+		void update() const;
+
+		/** Combines the transform of \a node in \a localPose with the derived
+		  transform of \a parent in \a derivedPose according to \a flags, and
+		  stores it as the derived transform of \a node. Used by update() and by
+		  users deriving poses of their own. */
+		static void deriveNode( const Pose &localPose, size_t node, int parent, uint8_t flags,
+				Pose *derivedPose );
+
+		//! Returns the number of update() passes.
+		size_t getGeneration() const { return mGeneration; }
+		//! Returns the generation in which the derived transform of \a node was last recalculated.
+		size_t getDerivedGeneration( size_t node ) const { return mDerivedGenerations[ node ]; }
+
+	private:
+		std::vector< int > mParents; /// parent index of each node, -1 for roots
+		std::vector< uint8_t > mFlags; /// inheritance flags of each node
+		Pose mLocalPose; /// transforms relative to the parents
+		mutable Pose mDerivedPose; /// transforms combined with those of the parents
+
+		mutable std::vector< ci::Matrix44f > mDerivedTransforms; /// cached matrices of mDerivedPose
+		mutable std::vector< size_t > mTransformGenerations; /// derived generation each cached matrix was built from
+
+		mutable std::vector< uint8_t > mDirty; /// nodes changed since the last update()
+		mutable std::vector< size_t > mDerivedGenerations; /// generation of the last recalculation of each node
+		mutable size_t mGeneration; /// incremented by every update() pass
+		mutable size_t mFirstDirty; /// lowest dirty node, the nodes before it are up to date
+
+		std::set< size_t > mFreeNodes; /// removed entries, reused by addNode()
+};
+
+} // namespace mndl
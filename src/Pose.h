@@ -0,0 +1,51 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "cinder/Cinder.h"
+#include "cinder/Vector.h"
+#include "cinder/Quaternion.h"
+
+namespace mndl {
+
+/** Transforms of a skeleton stored in flat arrays indexed by joint.
+  Joints are numbered so that parents always precede their children.
+  */
+class Pose
+{
+	public:
+		Pose() {}
+		Pose( size_t numJoints ) { resize( numJoints ); }
+
+		void resize( size_t numJoints )
+		{
+			mPositions.resize( numJoints );
+			mOrientations.resize( numJoints );
+			mScales.resize( numJoints, ci::Vec3f::one() );
+		}
+
+		size_t size() const { return mPositions.size(); }
+
+		std::vector< ci::Vec3f > mPositions;
+		std::vector< ci::Quatf > mOrientations;
+		std::vector< ci::Vec3f > mScales;
+};
+
+} // namespace mndl
@@ -0,0 +1,162 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PoseCache.h"
+
+using namespace ci;
+using namespace std;
+
+namespace mndl {
+
+PoseCache::PoseCache( size_t maxBytes /* = 16 * 1024 * 1024 */ ) :
+	mMaxBytes( maxBytes ),
+	mNumBytes( 0 ),
+	mNumHits( 0 ),
+	mNumMisses( 0 ),
+	mMissSeconds( 0.0 ),
+	mSavedSeconds( 0.0 )
+{
+}
+
+size_t PoseCache::getClipId( const string &name )
+{
+	lock_guard< mutex > lock( mMutex );
+	map< string, size_t >::const_iterator it = mClipIds.find( name );
+	if ( it != mClipIds.end() )
+		return it->second;
+
+	size_t id = mClipIds.size();
+	mClipIds[ name ] = id;
+	return id;
+}
+
+bool PoseCache::find( size_t clipId, int64_t tick, Pose *pose )
+{
+	lock_guard< mutex > lock( mMutex );
+	map< Key, EntryList::iterator >::iterator it = mEntryMap.find( Key( clipId, tick ) );
+	if ( it == mEntryMap.end() )
+	{
+		mNumMisses++;
+		return false;
+	}
+
+	// move to the front of the lru list
+	mEntries.splice( mEntries.begin(), mEntries, it->second );
+	*pose = it->second->mPose;
+
+	mNumHits++;
+	if ( mNumMisses > 0 )
+		mSavedSeconds += mMissSeconds / mNumMisses;
+	return true;
+}
+
+void PoseCache::insert( size_t clipId, int64_t tick, const Pose &pose, double sampleSeconds )
+{
+	lock_guard< mutex > lock( mMutex );
+	mMissSeconds += sampleSeconds;
+
+	Key key( clipId, tick );
+	// another thread might have inserted it since the lookup
+	if ( mEntryMap.find( key ) != mEntryMap.end() )
+		return;
+
+	size_t numBytes = sizeof( Entry ) + sizeof( Key ) + sizeof( EntryList::iterator ) +
+		pose.size() * ( 2 * sizeof( Vec3f ) + sizeof( Quatf ) );
+	if ( numBytes > mMaxBytes )
+		return;
+
+	mEntries.push_front( Entry() );
+	Entry &entry = mEntries.front();
+	entry.mKey = key;
+	entry.mPose = pose;
+	entry.mNumBytes = numBytes;
+	mEntryMap[ key ] = mEntries.begin();
+	mNumBytes += numBytes;
+
+	evict();
+}
+
+void PoseCache::evict()
+{
+	while ( mNumBytes > mMaxBytes && !mEntries.empty() )
+	{
+		const Entry &entry = mEntries.back();
+		mNumBytes -= entry.mNumBytes;
+		mEntryMap.erase( entry.mKey );
+		mEntries.pop_back();
+	}
+}
+
+void PoseCache::clear()
+{
+	lock_guard< mutex > lock( mMutex );
+	mEntries.clear();
+	mEntryMap.clear();
+	mNumBytes = 0;
+	mNumHits = 0;
+	mNumMisses = 0;
+	mMissSeconds = 0.0;
+	mSavedSeconds = 0.0;
+}
+
+void PoseCache::setMaxBytes( size_t maxBytes )
+{
+	lock_guard< mutex > lock( mMutex );
+	mMaxBytes = maxBytes;
+	evict();
+}
+
+size_t PoseCache::getNumBytes() const
+{
+	lock_guard< mutex > lock( mMutex );
+	return mNumBytes;
+}
+
+size_t PoseCache::getNumPoses() const
+{
+	lock_guard< mutex > lock( mMutex );
+	return mEntries.size();
+}
+
+size_t PoseCache::getNumHits() const
+{
+	lock_guard< mutex > lock( mMutex );
+	return mNumHits;
+}
+
+size_t PoseCache::getNumMisses() const
+{
+	lock_guard< mutex > lock( mMutex );
+	return mNumMisses;
+}
+
+double PoseCache::getHitRate() const
+{
+	lock_guard< mutex > lock( mMutex );
+	size_t lookups = mNumHits + mNumMisses;
+	if ( lookups == 0 )
+		return 0.0;
+	return double( mNumHits ) / lookups;
+}
+
+double PoseCache::getSavedSeconds() const
+{
+	lock_guard< mutex > lock( mMutex );
+	return mSavedSeconds;
+}
+
+} // namespace mndl
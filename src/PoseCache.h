@@ -0,0 +1,100 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "cinder/Cinder.h"
+#include "cinder/Thread.h"
+
+#include "Pose.h"
+
+namespace mndl {
+
+class PoseCache;
+
+typedef std::shared_ptr< PoseCache > PoseCacheRef;
+
+/** Least recently used cache of sampled animation poses.
+  Poses are keyed on a clip id and a quantized sample time, so models
+  playing the same clip at the same time can share the sampling work.
+  The cache can be used from several threads at once.
+  */
+class PoseCache
+{
+	public:
+		//! Creates a cache which holds at most \a maxBytes of poses.
+		PoseCache( size_t maxBytes = 16 * 1024 * 1024 );
+
+		//! Returns the id of the clip called \a name, assigning a new one for unknown names.
+		size_t getClipId( const std::string &name );
+
+		//! Copies the pose cached for \a clipId at \a tick to \a pose. Returns false if it is not in the cache.
+		bool find( size_t clipId, int64_t tick, Pose *pose );
+		//! Stores \a pose for \a clipId at \a tick, \a sampleSeconds is the time it took to compute.
+		void insert( size_t clipId, int64_t tick, const Pose &pose, double sampleSeconds );
+
+		//! Removes all poses and resets the statistics.
+		void clear();
+
+		void setMaxBytes( size_t maxBytes );
+		size_t getMaxBytes() const { return mMaxBytes; }
+
+		//! Returns the approximate memory used by the cached poses in bytes.
+		size_t getNumBytes() const;
+		size_t getNumPoses() const;
+
+		size_t getNumHits() const;
+		size_t getNumMisses() const;
+		//! Returns the ratio of lookups found in the cache.
+		double getHitRate() const;
+		//! Returns the estimated sampling time saved by cache hits in seconds.
+		double getSavedSeconds() const;
+
+	private:
+		typedef std::pair< size_t, int64_t > Key;
+
+		struct Entry
+		{
+			Key mKey;
+			Pose mPose;
+			size_t mNumBytes;
+		};
+
+		typedef std::list< Entry > EntryList;
+
+		void evict();
+
+		size_t mMaxBytes;
+		size_t mNumBytes;
+
+		EntryList mEntries; /// most recently used first
+		std::map< Key, EntryList::iterator > mEntryMap;
+		std::map< std::string, size_t > mClipIds;
+
+		size_t mNumHits;
+		size_t mNumMisses;
+		double mMissSeconds; /// total time of sampling the missing poses
+		double mSavedSeconds;
+
+		mutable std::mutex mMutex;
+};
+
+} // namespace mndl
@@ -0,0 +1,340 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SkinningKernels.h"
+
+#if defined( __i386__ ) || defined( __x86_64__ ) || defined( _M_IX86 ) || defined( _M_X64 )
+#define MNDL_SKINNING_X86 1
+#include <xmmintrin.h>
+#include <immintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define MNDL_SKINNING_X86 0
+#endif
+
+// gcc and clang only emit vector instructions in functions targeting them
+#if MNDL_SKINNING_X86 && defined( __GNUC__ )
+#define MNDL_TARGET_SSE __attribute__(( target( "sse" ) ))
+#define MNDL_TARGET_AVX __attribute__(( target( "avx" ) ))
+#else
+#define MNDL_TARGET_SSE
+#define MNDL_TARGET_AVX
+#endif
+
+using namespace ci;
+
+namespace mndl { namespace assimp {
+
+// Cinder matrices are column-major, the bone matrices are affine, so the
+// columns are the transformed x, y and z axes and the translation.
+//
+// The kernels are specialized on the number of influences per vertex and on
+// skinning normals, so the influence loops unroll and the hot loop has no
+// branches. Padding influences have zero weight and add nothing.
+
+template< size_t N, bool NORMALS >
+static void skinVerticesScalar( const SkinningData &data, size_t begin, size_t end )
+{
+	const uint16_t *bones = data.mBones + begin * N;
+	const float *weights = data.mWeights + begin * N;
+
+	for ( size_t v = begin; v < end; ++v, bones += N, weights += N )
+	{
+		// upper 3x4 part of the blended matrix
+		float m[ 12 ];
+		const float *b = data.mBoneMatrices[ bones[ 0 ] ].m;
+		float w = weights[ 0 ];
+		m[ 0 ] = w * b[ 0 ];  m[ 1 ] = w * b[ 1 ];  m[ 2 ] = w * b[ 2 ];
+		m[ 3 ] = w * b[ 4 ];  m[ 4 ] = w * b[ 5 ];  m[ 5 ] = w * b[ 6 ];
+		m[ 6 ] = w * b[ 8 ];  m[ 7 ] = w * b[ 9 ];  m[ 8 ] = w * b[ 10 ];
+		m[ 9 ] = w * b[ 12 ]; m[ 10 ] = w * b[ 13 ]; m[ 11 ] = w * b[ 14 ];
+		for ( size_t i = 1; i < N; ++i )
+		{
+			b = data.mBoneMatrices[ bones[ i ] ].m;
+			w = weights[ i ];
+			m[ 0 ] += w * b[ 0 ];  m[ 1 ] += w * b[ 1 ];  m[ 2 ] += w * b[ 2 ];
+			m[ 3 ] += w * b[ 4 ];  m[ 4 ] += w * b[ 5 ];  m[ 5 ] += w * b[ 6 ];
+			m[ 6 ] += w * b[ 8 ];  m[ 7 ] += w * b[ 9 ];  m[ 8 ] += w * b[ 10 ];
+			m[ 9 ] += w * b[ 12 ]; m[ 10 ] += w * b[ 13 ]; m[ 11 ] += w * b[ 14 ];
+		}
+
+		const aiVector3D &p = data.mPositions[ v ];
+		data.mSkinnedPositions[ v ] = Vec3f(
+				m[ 0 ] * p.x + m[ 3 ] * p.y + m[ 6 ] * p.z + m[ 9 ],
+				m[ 1 ] * p.x + m[ 4 ] * p.y + m[ 7 ] * p.z + m[ 10 ],
+				m[ 2 ] * p.x + m[ 5 ] * p.y + m[ 8 ] * p.z + m[ 11 ] );
+
+		if ( NORMALS )
+		{
+			// normals only get the rotation and scaling part
+			const aiVector3D &n = data.mNormals[ v ];
+			data.mSkinnedNormals[ v ] = Vec3f(
+					m[ 0 ] * n.x + m[ 3 ] * n.y + m[ 6 ] * n.z,
+					m[ 1 ] * n.x + m[ 4 ] * n.y + m[ 7 ] * n.z,
+					m[ 2 ] * n.x + m[ 5 ] * n.y + m[ 8 ] * n.z );
+		}
+	}
+}
+
+#if MNDL_SKINNING_X86
+
+//! Stores the xyz lanes of \a v without touching the memory after \a out.
+MNDL_TARGET_SSE static inline void storeVec3( Vec3f *out, __m128 v )
+{
+	_mm_storel_pi( reinterpret_cast< __m64 * >( &out->x ), v );
+	_mm_store_ss( &out->z, _mm_movehl_ps( v, v ) );
+}
+
+// one matrix column per register
+template< size_t N, bool NORMALS >
+MNDL_TARGET_SSE static void skinVerticesSse( const SkinningData &data, size_t begin, size_t end )
+{
+	const uint16_t *bones = data.mBones + begin * N;
+	const float *weights = data.mWeights + begin * N;
+
+	for ( size_t v = begin; v < end; ++v, bones += N, weights += N )
+	{
+		__m128 w = _mm_set1_ps( weights[ 0 ] );
+		const float *b = data.mBoneMatrices[ bones[ 0 ] ].m;
+		__m128 c0 = _mm_mul_ps( w, _mm_loadu_ps( b ) );
+		__m128 c1 = _mm_mul_ps( w, _mm_loadu_ps( b + 4 ) );
+		__m128 c2 = _mm_mul_ps( w, _mm_loadu_ps( b + 8 ) );
+		__m128 c3 = _mm_mul_ps( w, _mm_loadu_ps( b + 12 ) );
+		for ( size_t i = 1; i < N; ++i )
+		{
+			w = _mm_set1_ps( weights[ i ] );
+			b = data.mBoneMatrices[ bones[ i ] ].m;
+			c0 = _mm_add_ps( c0, _mm_mul_ps( w, _mm_loadu_ps( b ) ) );
+			c1 = _mm_add_ps( c1, _mm_mul_ps( w, _mm_loadu_ps( b + 4 ) ) );
+			c2 = _mm_add_ps( c2, _mm_mul_ps( w, _mm_loadu_ps( b + 8 ) ) );
+			c3 = _mm_add_ps( c3, _mm_mul_ps( w, _mm_loadu_ps( b + 12 ) ) );
+		}
+
+		const aiVector3D &p = data.mPositions[ v ];
+		__m128 r = _mm_add_ps(
+				_mm_add_ps( _mm_mul_ps( c0, _mm_set1_ps( p.x ) ),
+							_mm_mul_ps( c1, _mm_set1_ps( p.y ) ) ),
+				_mm_add_ps( _mm_mul_ps( c2, _mm_set1_ps( p.z ) ), c3 ) );
+		storeVec3( &data.mSkinnedPositions[ v ], r );
+
+		if ( NORMALS )
+		{
+			const aiVector3D &n = data.mNormals[ v ];
+			r = _mm_add_ps(
+					_mm_add_ps( _mm_mul_ps( c0, _mm_set1_ps( n.x ) ),
+								_mm_mul_ps( c1, _mm_set1_ps( n.y ) ) ),
+					_mm_mul_ps( c2, _mm_set1_ps( n.z ) ) );
+			storeVec3( &data.mSkinnedNormals[ v ], r );
+		}
+	}
+}
+
+MNDL_TARGET_AVX static inline __m256 broadcastPair( float lo, float hi )
+{
+	return _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_set1_ps( lo ) ),
+			_mm_set1_ps( hi ), 1 );
+}
+
+// two matrix columns per register, the halves are summed at the end
+template< size_t N, bool NORMALS >
+MNDL_TARGET_AVX static void skinVerticesAvx( const SkinningData &data, size_t begin, size_t end )
+{
+	const uint16_t *bones = data.mBones + begin * N;
+	const float *weights = data.mWeights + begin * N;
+
+	for ( size_t v = begin; v < end; ++v, bones += N, weights += N )
+	{
+		__m256 w = _mm256_set1_ps( weights[ 0 ] );
+		const float *b = data.mBoneMatrices[ bones[ 0 ] ].m;
+		__m256 c01 = _mm256_mul_ps( w, _mm256_loadu_ps( b ) );
+		__m256 c23 = _mm256_mul_ps( w, _mm256_loadu_ps( b + 8 ) );
+		for ( size_t i = 1; i < N; ++i )
+		{
+			w = _mm256_set1_ps( weights[ i ] );
+			b = data.mBoneMatrices[ bones[ i ] ].m;
+			c01 = _mm256_add_ps( c01, _mm256_mul_ps( w, _mm256_loadu_ps( b ) ) );
+			c23 = _mm256_add_ps( c23, _mm256_mul_ps( w, _mm256_loadu_ps( b + 8 ) ) );
+		}
+
+		const aiVector3D &p = data.mPositions[ v ];
+		__m256 s = _mm256_add_ps( _mm256_mul_ps( c01, broadcastPair( p.x, p.y ) ),
+								  _mm256_mul_ps( c23, broadcastPair( p.z, 1.0f ) ) );
+		__m128 r = _mm_add_ps( _mm256_castps256_ps128( s ), _mm256_extractf128_ps( s, 1 ) );
+		storeVec3( &data.mSkinnedPositions[ v ], r );
+
+		if ( NORMALS )
+		{
+			const aiVector3D &n = data.mNormals[ v ];
+			s = _mm256_add_ps( _mm256_mul_ps( c01, broadcastPair( n.x, n.y ) ),
+							   _mm256_mul_ps( c23, broadcastPair( n.z, 0.0f ) ) );
+			r = _mm_add_ps( _mm256_castps256_ps128( s ), _mm256_extractf128_ps( s, 1 ) );
+			storeVec3( &data.mSkinnedNormals[ v ], r );
+		}
+	}
+}
+
+static void cpuid( int leaf, unsigned *regs )
+{
+#if defined( _MSC_VER )
+	int info[ 4 ];
+	__cpuid( info, leaf );
+	for ( int i = 0; i < 4; ++i )
+		regs[ i ] = unsigned( info[ i ] );
+#else
+	regs[ 0 ] = regs[ 1 ] = regs[ 2 ] = regs[ 3 ] = 0;
+	__get_cpuid( leaf, &regs[ 0 ], &regs[ 1 ], &regs[ 2 ], &regs[ 3 ] );
+#endif
+}
+
+static bool detectSse()
+{
+	unsigned regs[ 4 ];
+	cpuid( 1, regs );
+	return ( regs[ 3 ] & ( 1u << 25 ) ) != 0;
+}
+
+static bool detectAvx()
+{
+	unsigned regs[ 4 ];
+	cpuid( 1, regs );
+	// the cpu has to support avx and the os has to save the ymm registers
+	const unsigned osxsave = 1u << 27;
+	const unsigned avx = 1u << 28;
+	if ( ( regs[ 2 ] & ( osxsave | avx ) ) != ( osxsave | avx ) )
+		return false;
+
+#if defined( _MSC_VER )
+	unsigned long long xcr0 = _xgetbv( 0 );
+#else
+	unsigned eax, edx;
+	__asm__ __volatile__ ( "xgetbv" : "=a" ( eax ), "=d" ( edx ) : "c" ( 0 ) );
+	unsigned long long xcr0 = ( (unsigned long long)edx << 32 ) | eax;
+#endif
+	return ( xcr0 & 6 ) == 6;
+}
+
+#endif // MNDL_SKINNING_X86
+
+bool isSkinningKernelSupported( SkinningKernel kernel )
+{
+#if MNDL_SKINNING_X86
+	static const bool sse = detectSse();
+	static const bool avx = sse && detectAvx();
+#else
+	static const bool sse = false;
+	static const bool avx = false;
+#endif
+
+	switch ( kernel )
+	{
+		case SKINNING_KERNEL_SCALAR:
+			return true;
+
+		case SKINNING_KERNEL_SSE:
+			return sse;
+
+		case SKINNING_KERNEL_AVX:
+			return avx;
+	}
+	return false;
+}
+
+SkinningKernel getBestSkinningKernel()
+{
+	if ( isSkinningKernelSupported( SKINNING_KERNEL_AVX ) )
+		return SKINNING_KERNEL_AVX;
+	else if ( isSkinningKernelSupported( SKINNING_KERNEL_SSE ) )
+		return SKINNING_KERNEL_SSE;
+	else
+		return SKINNING_KERNEL_SCALAR;
+}
+
+const char *getSkinningKernelName( SkinningKernel kernel )
+{
+	switch ( kernel )
+	{
+		case SKINNING_KERNEL_SCALAR:
+			return "scalar";
+
+		case SKINNING_KERNEL_SSE:
+			return "sse";
+
+		case SKINNING_KERNEL_AVX:
+			return "avx";
+	}
+	return "unknown";
+}
+
+size_t getSkinningNumInfluences( size_t maxInfluences )
+{
+	if ( maxInfluences <= 1 )
+		return 1;
+	else if ( maxInfluences <= 2 )
+		return 2;
+	else if ( maxInfluences <= 4 )
+		return 4;
+	else
+		return 8;
+}
+
+// kernel specializations indexed by influence count and normals
+#define MNDL_SKINNING_FUNCS( kernel ) \
+	{ { &kernel< 1, false >, &kernel< 1, true > }, \
+	  { &kernel< 2, false >, &kernel< 2, true > }, \
+	  { &kernel< 4, false >, &kernel< 4, true > }, \
+	  { &kernel< 8, false >, &kernel< 8, true > } }
+
+SkinningFunc getSkinningFunc( SkinningKernel kernel, size_t numInfluences, bool normals )
+{
+	static const SkinningFunc scalarFuncs[ 4 ][ 2 ] = MNDL_SKINNING_FUNCS( skinVerticesScalar );
+#if MNDL_SKINNING_X86
+	static const SkinningFunc sseFuncs[ 4 ][ 2 ] = MNDL_SKINNING_FUNCS( skinVerticesSse );
+	static const SkinningFunc avxFuncs[ 4 ][ 2 ] = MNDL_SKINNING_FUNCS( skinVerticesAvx );
+#endif
+
+	size_t n;
+	switch ( numInfluences )
+	{
+		case 1: n = 0; break;
+		case 2: n = 1; break;
+		case 4: n = 2; break;
+		case 8: n = 3; break;
+		default: return NULL;
+	}
+
+	switch ( kernel )
+	{
+#if MNDL_SKINNING_X86
+		case SKINNING_KERNEL_SSE:
+			return sseFuncs[ n ][ normals ];
+
+		case SKINNING_KERNEL_AVX:
+			return avxFuncs[ n ][ normals ];
+#endif
+
+		default:
+			return scalarFuncs[ n ][ normals ];
+	}
+}
+
+#undef MNDL_SKINNING_FUNCS
+
+} } // namespace mndl::assimp
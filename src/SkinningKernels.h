@@ -0,0 +1,78 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "assimp/types.h"
+
+#include "cinder/Cinder.h"
+#include "cinder/Vector.h"
+#include "cinder/Matrix.h"
+
+namespace mndl { namespace assimp {
+
+//! Skinning kernel implementations.
+enum SkinningKernel
+{
+	SKINNING_KERNEL_SCALAR,
+	SKINNING_KERNEL_SSE,
+	SKINNING_KERNEL_AVX
+};
+
+/** Arrays read and written by the skinning kernels.
+  Bone indices and weights are stored vertex-major, mNumInfluences per
+  vertex, ordered by decreasing weight and padded with zero weights of
+  bone 0. mNumInfluences is 1, 2, 4 or 8.
+  */
+struct SkinningData
+{
+	const aiVector3D *mPositions;
+	const aiVector3D *mNormals; /// NULL if there are no normals to skin
+
+	const uint16_t *mBones;
+	const float *mWeights;
+	size_t mNumInfluences;
+
+	const ci::Matrix44f *mBoneMatrices;
+
+	ci::Vec3f *mSkinnedPositions;
+	ci::Vec3f *mSkinnedNormals;
+};
+
+//! Returns true if the CPU and the build support \a kernel.
+bool isSkinningKernelSupported( SkinningKernel kernel );
+
+//! Returns the fastest kernel supported by the CPU.
+SkinningKernel getBestSkinningKernel();
+
+//! Returns the name of \a kernel.
+const char *getSkinningKernelName( SkinningKernel kernel );
+
+//! Skins the vertices from \a begin to \a end of \a data.
+typedef void ( *SkinningFunc )( const SkinningData &data, size_t begin, size_t end );
+
+//! Returns the influence count of the tightest kernel for vertices with at most \a maxInfluences bones, 1, 2, 4 or 8.
+size_t getSkinningNumInfluences( size_t maxInfluences );
+
+/** Returns \a kernel specialized for \a numInfluences bones per vertex and
+  for skinning normals or positions only. Meshes pick their function once,
+  so the per-vertex loop has no branches. Returns NULL if \a numInfluences
+  is not 1, 2, 4 or 8.
+  */
+SkinningFunc getSkinningFunc( SkinningKernel kernel, size_t numInfluences, bool normals );
+
+} } // namespace mndl::assimp
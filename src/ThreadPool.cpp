@@ -0,0 +1,175 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace mndl {
+
+ThreadPool::ThreadPool( size_t numThreads /* = 0 */ ) :
+	mGeneration( 0 ),
+	mPendingTasks( 0 ),
+	mQuit( false )
+{
+	if ( numThreads == 0 )
+		numThreads = thread::hardware_concurrency();
+	if ( numThreads == 0 )
+		numThreads = 1;
+
+	for ( size_t i = 0; i < numThreads; ++i )
+		mQueues.push_back( shared_ptr< Queue >( new Queue() ) );
+
+	// the calling thread works on queue 0
+	for ( size_t i = 1; i < numThreads; ++i )
+		mThreads.push_back( shared_ptr< thread >(
+					new thread( bind( &ThreadPool::workerLoop, this, i ) ) ) );
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard< mutex > lock( mMutex );
+		mQuit = true;
+	}
+	mWakeCond.notify_all();
+
+	for ( vector< shared_ptr< thread > >::iterator it = mThreads.begin();
+			it != mThreads.end(); ++it )
+	{
+		(*it)->join();
+	}
+}
+
+void ThreadPool::run( size_t begin, size_t end, InvokeFunc invokeFunc, const void *func,
+		size_t grainSize )
+{
+	if ( begin >= end )
+		return;
+	if ( grainSize == 0 )
+		grainSize = 1;
+
+	unique_lock< mutex > busyLock( mBusyMutex, try_to_lock );
+	if ( !busyLock.owns_lock() || mThreads.empty() || ( end - begin ) <= grainSize )
+	{
+		// nested or concurrent call, or nothing to split
+		for ( size_t i = begin; i < end; i += grainSize )
+			invokeFunc( func, i, min( i + grainSize, end ) );
+		return;
+	}
+
+	size_t numTasks = ( end - begin + grainSize - 1 ) / grainSize;
+	mPendingTasks = numTasks;
+
+	// deal out the ranges round-robin so each thread starts on its own queue
+	for ( size_t t = 0; t < numTasks; ++t )
+	{
+		Range range;
+		range.mBegin = begin + t * grainSize;
+		range.mEnd = min( range.mBegin + grainSize, end );
+		range.mInvokeFunc = invokeFunc;
+		range.mFunc = func;
+
+		Queue &queue = *mQueues[ t % mQueues.size() ];
+		lock_guard< mutex > queueLock( queue.mMutex );
+		if ( queue.mFront == queue.mRanges.size() )
+		{
+			// drained, keeps the capacity
+			queue.mRanges.clear();
+			queue.mFront = 0;
+		}
+		queue.mRanges.push_back( range );
+	}
+
+	{
+		lock_guard< mutex > lock( mMutex );
+		mGeneration++;
+	}
+	mWakeCond.notify_all();
+
+	runTasks( 0 );
+
+	unique_lock< mutex > lock( mMutex );
+	while ( mPendingTasks > 0 )
+		mDoneCond.wait( lock );
+}
+
+void ThreadPool::workerLoop( size_t queueId )
+{
+	size_t generation = 0;
+	for ( ;; )
+	{
+		{
+			unique_lock< mutex > lock( mMutex );
+			while ( !mQuit && ( generation == mGeneration ) )
+				mWakeCond.wait( lock );
+			if ( mQuit )
+				return;
+			generation = mGeneration;
+		}
+
+		runTasks( queueId );
+	}
+}
+
+void ThreadPool::runTasks( size_t queueId )
+{
+	Range range;
+	while ( popTask( queueId, &range ) )
+	{
+		range.mInvokeFunc( range.mFunc, range.mBegin, range.mEnd );
+
+		// the lock keeps the notification from slipping in between the
+		// check and the wait in run()
+		if ( --mPendingTasks == 0 )
+		{
+			lock_guard< mutex > lock( mMutex );
+			mDoneCond.notify_all();
+		}
+	}
+}
+
+bool ThreadPool::popTask( size_t queueId, Range *range )
+{
+	// own work from the back
+	{
+		Queue &queue = *mQueues[ queueId ];
+		lock_guard< mutex > lock( queue.mMutex );
+		if ( queue.mFront < queue.mRanges.size() )
+		{
+			*range = queue.mRanges.back();
+			queue.mRanges.pop_back();
+			return true;
+		}
+	}
+
+	// steal from the front of the other queues
+	for ( size_t i = 1; i < mQueues.size(); ++i )
+	{
+		Queue &queue = *mQueues[ ( queueId + i ) % mQueues.size() ];
+		lock_guard< mutex > lock( queue.mMutex );
+		if ( queue.mFront < queue.mRanges.size() )
+		{
+			*range = queue.mRanges[ queue.mFront++ ];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+} // namespace mndl
@@ -0,0 +1,110 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+
+#include "cinder/Cinder.h"
+#include "cinder/Thread.h"
+
+namespace mndl {
+
+class ThreadPool;
+
+typedef std::shared_ptr< ThreadPool > ThreadPoolRef;
+
+/** Fixed size pool of worker threads.
+  Work is split into index ranges, which are distributed among per-thread
+  queues. Threads run their own ranges first and steal from the others
+  when they run out of work.
+  */
+class ThreadPool
+{
+	public:
+		//! Creates a pool with \a numThreads threads including the calling thread. 0 uses the number of hardware threads.
+		ThreadPool( size_t numThreads = 0 );
+		~ThreadPool();
+
+		//! Returns the number of threads working on a parallelFor() including the calling thread.
+		size_t getNumThreads() const { return mQueues.size(); }
+
+		/** Calls \a func( rangeBegin, rangeEnd ) for consecutive ranges of at most
+		  \a grainSize indices covering [ \a begin, \a end ) and returns when all
+		  calls have finished. \a func should not throw. Calls issued while the
+		  pool is busy, for example from inside \a func, run on the calling thread.
+		  Once the queues have grown to the number of ranges, no memory is
+		  allocated.
+		  */
+		template< typename Func >
+		void parallelFor( size_t begin, size_t end, const Func &func, size_t grainSize = 1 )
+		{
+			run( begin, end, &invoke< Func >, &func, grainSize );
+		}
+
+	private:
+		typedef void ( *InvokeFunc )( const void *func, size_t begin, size_t end );
+
+		//! Carries its callable, so running it needs no shared state.
+		struct Range
+		{
+			size_t mBegin;
+			size_t mEnd;
+			InvokeFunc mInvokeFunc;
+			const void *mFunc;
+		};
+
+		//! Ranges are only added while the queues are idle, so a vector with a moving front is enough.
+		struct Queue
+		{
+			Queue() : mFront( 0 ) {}
+
+			std::mutex mMutex;
+			std::vector< Range > mRanges;
+			size_t mFront;
+		};
+
+		template< typename Func >
+		static void invoke( const void *func, size_t begin, size_t end )
+		{
+			( *static_cast< const Func * >( func ) )( begin, end );
+		}
+
+		void run( size_t begin, size_t end, InvokeFunc invokeFunc, const void *func, size_t grainSize );
+
+		ThreadPool( const ThreadPool & );
+		ThreadPool &operator=( const ThreadPool & );
+
+		void workerLoop( size_t queueId );
+		void runTasks( size_t queueId );
+		bool popTask( size_t queueId, Range *range );
+
+		std::vector< std::shared_ptr< Queue > > mQueues; /// queue 0 belongs to the calling thread
+		std::vector< std::shared_ptr< std::thread > > mThreads;
+
+		std::mutex mBusyMutex; /// held during a parallelFor
+
+		std::mutex mMutex;
+		std::condition_variable mWakeCond;
+		std::condition_variable mDoneCond;
+		size_t mGeneration;
+		std::atomic< size_t > mPendingTasks; /// mMutex is only taken to signal the last one
+		bool mQuit;
+};
+
+} // namespace mndl
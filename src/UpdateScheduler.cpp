@@ -0,0 +1,79 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <functional>
+
+#include "cinder/Timer.h"
+
+#include "UpdateScheduler.h"
+
+using namespace ci;
+using namespace std;
+
+namespace mndl { namespace assimp {
+
+UpdateScheduler::UpdateScheduler( double budgetSeconds /* = 0.004 */, size_t maxSkippedUpdates /* = 8 */ ) :
+	mBudgetSeconds( budgetSeconds ),
+	mMaxSkippedUpdates( maxSkippedUpdates ),
+	mNumUpdated( 0 ),
+	mNumSkipped( 0 ),
+	mSeconds( 0.0 )
+{
+}
+
+void UpdateScheduler::update( const vector< AssimpInstance > &instances )
+{
+	Timer timer;
+	timer.start();
+
+	// models that waited longer get more important, so everyone gets its turn
+	mOrder.resize( instances.size() );
+	for ( size_t i = 0; i < instances.size(); ++i )
+	{
+		const AssimpLoader *loader = instances[ i ].mLoader;
+		float waited = float( loader->getNumSkippedUpdates() + 1 );
+		mOrder[ i ] = make_pair( instances[ i ].mPriority * waited, i );
+	}
+	sort( mOrder.begin(), mOrder.end(), greater< pair< float, size_t > >() );
+
+	mNumUpdated = 0;
+	mNumSkipped = 0;
+	for ( size_t i = 0; i < mOrder.size(); ++i )
+	{
+		const AssimpInstance &instance = instances[ mOrder[ i ].second ];
+		AssimpLoader *loader = instance.mLoader;
+
+		if ( ( timer.getSeconds() < mBudgetSeconds ) ||
+			 ( loader->getNumSkippedUpdates() >= mMaxSkippedUpdates ) )
+		{
+			loader->setTime( instance.mTime );
+			loader->update();
+			mNumUpdated++;
+		}
+		else
+		{
+			loader->skipUpdate();
+			mNumSkipped++;
+		}
+	}
+
+	timer.stop();
+	mSeconds = timer.getSeconds();
+}
+
+} } // namespace mndl::assimp
@@ -0,0 +1,66 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "AssimpLoader.h"
+
+namespace mndl { namespace assimp {
+
+/** Updates a set of models within a time budget per frame.
+  Models are updated in the order of their priority multiplied by the
+  number of frames they have been waiting, so important models stay
+  smooth while the others are updated at a lower rate. Models waiting for
+  more than the maximum number of frames are always updated.
+  */
+class UpdateScheduler
+{
+	public:
+		UpdateScheduler( double budgetSeconds = 0.004, size_t maxSkippedUpdates = 8 );
+
+		//! Sets the time that can be spent on updates in one frame.
+		void setBudget( double seconds ) { mBudgetSeconds = seconds; }
+		double getBudget() const { return mBudgetSeconds; }
+
+		//! Sets the number of frames after which a model is updated regardless of the budget.
+		void setMaxSkippedUpdates( size_t n ) { mMaxSkippedUpdates = n; }
+		size_t getMaxSkippedUpdates() const { return mMaxSkippedUpdates; }
+
+		//! Updates the most important \a instances that fit into the budget and skips the rest.
+		void update( const std::vector< AssimpInstance > &instances );
+
+		//! Returns the number of models updated in the last update().
+		size_t getNumUpdated() const { return mNumUpdated; }
+		//! Returns the number of models skipped in the last update().
+		size_t getNumSkipped() const { return mNumSkipped; }
+		//! Returns the time spent in the last update() in seconds.
+		double getSeconds() const { return mSeconds; }
+
+	private:
+		double mBudgetSeconds;
+		size_t mMaxSkippedUpdates;
+
+		std::vector< std::pair< float, size_t > > mOrder; /// score and instance index
+
+		size_t mNumUpdated;
+		size_t mNumSkipped;
+		double mSeconds;
+};
+
+} } // namespace mndl::assimp
@@ -0,0 +1,140 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Counts the heap allocations of update() and draw() of an animated model
+   by replacing the global operator new. After a warm-up every frame has to
+   run without allocating, the program exits with 1 if any frame allocated.
+   Build it as a Cinder application with the block's src/ files and the
+   assimp library, like samples/AssimpApp, and run it with the model path:
+     AllocationTest ../samples/AssimpApp/assets/astroboy_walk.dae
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "cinder/app/AppBasic.h"
+
+#include "AssimpLoader.h"
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+using namespace mndl;
+
+static atomic< bool > sCounting( false );
+static atomic< size_t > sNumAllocations( 0 );
+
+void *operator new( size_t size )
+{
+	if ( sCounting )
+		sNumAllocations++;
+	void *p = malloc( size ? size : 1 );
+	if ( !p )
+		throw bad_alloc();
+	return p;
+}
+
+void *operator new[]( size_t size )
+{
+	return operator new( size );
+}
+
+void operator delete( void *p ) throw()
+{
+	free( p );
+}
+
+void operator delete[]( void *p ) throw()
+{
+	free( p );
+}
+
+class AllocationTest : public AppBasic
+{
+	public:
+		void setup();
+
+		void update();
+		void draw();
+
+	private:
+		assimp::AssimpLoader mAssimpLoader;
+
+		int mFrame;
+		size_t mNumFailedFrames;
+		size_t mMaxAllocations;
+};
+
+static const int sNumWarmUpFrames = 60;
+static const int sNumTestFrames = 600;
+
+void AllocationTest::setup()
+{
+	if ( getArgs().size() < 2 )
+	{
+		console() << "usage: AllocationTest model" << endl;
+		exit( 2 );
+	}
+
+	mAssimpLoader = assimp::AssimpLoader( getArgs()[ 1 ] );
+	mAssimpLoader.setAnimation( 0 );
+	mAssimpLoader.enableAnimation();
+	mAssimpLoader.enableSkinning();
+
+	mFrame = 0;
+	mNumFailedFrames = 0;
+	mMaxAllocations = 0;
+}
+
+void AllocationTest::update()
+{
+	if ( mFrame >= sNumWarmUpFrames )
+	{
+		sNumAllocations = 0;
+		sCounting = true;
+	}
+
+	double time = fmod( getElapsedSeconds(), mAssimpLoader.getAnimationDuration( 0 ) );
+	mAssimpLoader.setTime( time );
+	mAssimpLoader.update();
+}
+
+void AllocationTest::draw()
+{
+	gl::clear( Color::black() );
+	mAssimpLoader.draw();
+
+	sCounting = false;
+	if ( mFrame >= sNumWarmUpFrames )
+	{
+		size_t numAllocations = sNumAllocations;
+		if ( numAllocations > 0 )
+			mNumFailedFrames++;
+		mMaxAllocations = math< size_t >::max( mMaxAllocations, numAllocations );
+	}
+
+	if ( ++mFrame == sNumWarmUpFrames + sNumTestFrames )
+	{
+		console() << mNumFailedFrames << " of " << sNumTestFrames <<
+			" frames allocated, at most " << mMaxAllocations << " allocations per frame" << endl;
+		exit( mNumFailedFrames > 0 ? 1 : 0 );
+	}
+}
+
+CINDER_APP_BASIC( AllocationTest, RendererGl(0) )
@@ -0,0 +1,195 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Skins a random 20000 vertex mesh with the gpu skinning shader in a
+   headless EGL context, reads it back via transform feedback and compares
+   it with the scalar cpu kernel, for 4 and 8 influences per vertex. Every
+   97th vertex has no weights and has to stay in place. Exits with 1 if the
+   difference is above the tolerance, and with 2 if the context has no
+   transform feedback.
+   Build on Linux with:
+     g++ -O2 -I../src -I$CINDER_PATH/include GpuSkinningTest.cpp \
+       ../src/GpuSkinning.cpp ../src/SkinningKernels.cpp \
+       $CINDER_PATH/src/cinder/gl/GlslProg.cpp $CINDER_PATH/src/cinder/gl/Vbo.cpp -lEGL -lGL
+   Without a display run it with EGL_PLATFORM=surfaceless, on Mesa
+   LIBGL_ALWAYS_SOFTWARE=1 runs it on llvmpipe without a gpu.
+ */
+
+#include <EGL/egl.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "AssimpLoader.h"
+#include "GpuSkinning.h"
+#include "SkinningKernels.h"
+
+using namespace ci;
+using namespace std;
+using namespace mndl::assimp;
+
+static const size_t sNumVertices = 20000;
+static const size_t sNumBones = 40;
+static const size_t sPaletteSize = 100;
+static const float sTolerance = 1e-4f;
+
+static bool createContext()
+{
+	EGLDisplay display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+	EGLint major, minor;
+	if ( !eglInitialize( display, &major, &minor ) )
+		return false;
+	eglBindAPI( EGL_OPENGL_API );
+
+	const EGLint configAttribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint numConfigs;
+	if ( !eglChooseConfig( display, configAttribs, &config, 1, &numConfigs ) || ( numConfigs == 0 ) )
+		return false;
+
+	// the shader uses the fixed function built-ins
+	const EGLint contextAttribs[] = { EGL_CONTEXT_OPENGL_PROFILE_MASK,
+		EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT, EGL_NONE };
+	EGLContext context = eglCreateContext( display, config, EGL_NO_CONTEXT, contextAttribs );
+	const EGLint surfaceAttribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+	EGLSurface surface = eglCreatePbufferSurface( display, config, surfaceAttribs );
+	return ( context != EGL_NO_CONTEXT ) && eglMakeCurrent( display, surface, surface, context );
+}
+
+int main()
+{
+	if ( !createContext() )
+	{
+		printf( "no EGL context\n" );
+		return 2;
+	}
+	printf( "%s, %s\n", glGetString( GL_VERSION ), glGetString( GL_RENDERER ) );
+
+	mt19937 rng( 3 );
+	uniform_real_distribution< float > random( -1.0f, 1.0f );
+
+	aiMesh *mesh = new aiMesh();
+	mesh->mNumVertices = sNumVertices;
+	mesh->mVertices = new aiVector3D[ sNumVertices ];
+	mesh->mNormals = new aiVector3D[ sNumVertices ];
+	for ( size_t v = 0; v < sNumVertices; ++v )
+	{
+		mesh->mVertices[ v ] = aiVector3D( random( rng ), random( rng ), random( rng ) );
+		mesh->mNormals[ v ] = aiVector3D( random( rng ), random( rng ), random( rng ) );
+	}
+
+	AssimpMeshRef assimpMeshRef( new AssimpMesh() );
+	assimpMeshRef->mAiMesh = mesh;
+	assimpMeshRef->mBoneJoints.resize( sNumBones );
+	assimpMeshRef->mBonePaletteIndices.resize( sNumBones );
+	for ( size_t a = 0; a < sNumBones; ++a )
+		assimpMeshRef->mBonePaletteIndices[ a ] = ( a * 7 + 3 ) % sPaletteSize;
+	assimpMeshRef->mIndices.resize( sNumVertices - sNumVertices % 3 );
+	for ( size_t i = 0; i < assimpMeshRef->mIndices.size(); ++i )
+		assimpMeshRef->mIndices[ i ] = uint32_t( i );
+
+	vector< Matrix44f > palette( sPaletteSize );
+	for ( size_t b = 0; b < sPaletteSize; ++b )
+	{
+		for ( int i = 0; i < 16; ++i )
+			palette[ b ].m[ i ] = random( rng );
+		palette[ b ].m[ 3 ] = palette[ b ].m[ 7 ] = palette[ b ].m[ 11 ] = 0.0f;
+		palette[ b ].m[ 15 ] = 1.0f;
+	}
+
+	GpuSkinning gpuSkinning;
+	if ( !gpuSkinning.isReadBackSupported() )
+	{
+		printf( "no transform feedback\n" );
+		return 2;
+	}
+
+	bool passed = true;
+	const size_t influenceCounts[] = { 4, 8 };
+	for ( size_t c = 0; c < 2; ++c )
+	{
+		// weights sorted in decreasing order and normalized, like the loader stores them
+		const size_t numInfluences = influenceCounts[ c ];
+		assimpMeshRef->mNumInfluences = numInfluences;
+		assimpMeshRef->mInfluenceBones.assign( sNumVertices * numInfluences, 0 );
+		assimpMeshRef->mInfluenceWeights.assign( sNumVertices * numInfluences, 0.0f );
+		for ( size_t v = 0; v < sNumVertices; ++v )
+		{
+			if ( v % 97 == 0 )
+				continue;
+
+			vector< float > weights( 1 + rng() % numInfluences );
+			float sum = 0.0f;
+			for ( size_t i = 0; i < weights.size(); ++i )
+			{
+				weights[ i ] = 0.1f + math< float >::abs( random( rng ) );
+				sum += weights[ i ];
+			}
+			sort( weights.begin(), weights.end(), greater< float >() );
+			for ( size_t i = 0; i < weights.size(); ++i )
+			{
+				assimpMeshRef->mInfluenceBones[ v * numInfluences + i ] =
+					uint16_t( assimpMeshRef->mBonePaletteIndices[ rng() % sNumBones ] );
+				assimpMeshRef->mInfluenceWeights[ v * numInfluences + i ] = weights[ i ] / sum;
+			}
+		}
+		gpuSkinning.setup( assimpMeshRef );
+
+		vector< Vec3f > gpuPositions, gpuNormals;
+		gpuSkinning.readBack( assimpMeshRef, palette, &gpuPositions, &gpuNormals );
+
+		vector< Vec3f > cpuPositions( sNumVertices ), cpuNormals( sNumVertices );
+		SkinningData data;
+		data.mPositions = mesh->mVertices;
+		data.mNormals = mesh->mNormals;
+		data.mBones = &assimpMeshRef->mInfluenceBones[ 0 ];
+		data.mWeights = &assimpMeshRef->mInfluenceWeights[ 0 ];
+		data.mNumInfluences = numInfluences;
+		data.mBoneMatrices = &palette[ 0 ];
+		data.mSkinnedPositions = &cpuPositions[ 0 ];
+		data.mSkinnedNormals = &cpuNormals[ 0 ];
+		getSkinningFunc( SKINNING_KERNEL_SCALAR, numInfluences, true )( data, 0, sNumVertices );
+
+		float skinnedError = 0.0f;
+		float staticError = 0.0f;
+		for ( size_t v = 0; v < sNumVertices; ++v )
+		{
+			if ( v % 97 == 0 )
+			{
+				staticError = math< float >::max( staticError,
+						gpuPositions[ v ].distance( fromAssimp( mesh->mVertices[ v ] ) ) );
+				staticError = math< float >::max( staticError,
+						gpuNormals[ v ].distance( fromAssimp( mesh->mNormals[ v ] ) ) );
+				continue;
+			}
+			skinnedError = math< float >::max( skinnedError, gpuPositions[ v ].distance( cpuPositions[ v ] ) );
+			skinnedError = math< float >::max( skinnedError, gpuNormals[ v ].distance( cpuNormals[ v ] ) );
+		}
+
+		printf( "%zu influences: max skinned error %g, max static error %g, gl error 0x%x\n",
+				numInfluences, skinnedError, staticError, glGetError() );
+		if ( ( skinnedError > sTolerance ) || ( staticError > sTolerance ) )
+			passed = false;
+	}
+
+	printf( passed ? "passed\n" : "FAILED\n" );
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Loads, animates, copies and releases a model once per frame and checks
+   that the resident memory stays flat. The size after the warm-up cycles is
+   the baseline, the program exits with 1 if the process grows by more than
+   the tolerance until the last cycle.
+   Build it as a Cinder application with the block's src/ files and the
+   assimp library, like samples/AssimpApp, and run it with the model path:
+     LoadSoakTest ../samples/AssimpApp/assets/astroboy_walk.dae
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#if defined( __APPLE__ )
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "cinder/app/AppBasic.h"
+
+#include "AssimpLoader.h"
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+using namespace mndl;
+
+//! Returns the resident size of the process in kilobytes.
+static size_t getResidentKb()
+{
+#if defined( __APPLE__ )
+	mach_task_basic_info info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if ( task_info( mach_task_self(), MACH_TASK_BASIC_INFO,
+				reinterpret_cast< task_info_t >( &info ), &count ) != KERN_SUCCESS )
+		return 0;
+	return info.resident_size / 1024;
+#else
+	long pages = 0, resident = 0;
+	FILE *file = fopen( "/proc/self/statm", "r" );
+	if ( !file )
+		return 0;
+	if ( fscanf( file, "%ld %ld", &pages, &resident ) != 2 )
+		resident = 0;
+	fclose( file );
+	return size_t( resident ) * sysconf( _SC_PAGESIZE ) / 1024;
+#endif
+}
+
+class LoadSoakTest : public AppBasic
+{
+	public:
+		void setup();
+
+		void update();
+
+	private:
+		fs::path mModelPath;
+
+		int mCycle;
+		size_t mBaselineKb;
+};
+
+static const int sNumWarmUpCycles = 50;
+static const int sNumCycles = 1000;
+static const size_t sToleranceKb = 4096;
+
+void LoadSoakTest::setup()
+{
+	if ( getArgs().size() < 2 )
+	{
+		console() << "usage: LoadSoakTest model" << endl;
+		exit( 2 );
+	}
+
+	mModelPath = getArgs()[ 1 ];
+	mCycle = 0;
+	mBaselineKb = 0;
+}
+
+void LoadSoakTest::update()
+{
+	{
+		// the copy shares the nodes of the model, both have to let them go
+		assimp::AssimpLoader loader( mModelPath );
+		loader.setAnimation( 0 );
+		loader.enableAnimation();
+		loader.enableSkinning();
+		for ( int i = 0; i < 4; ++i )
+		{
+			loader.setTime( i * 0.1 );
+			loader.update();
+		}
+		assimp::AssimpLoader copy = loader;
+		copy.update();
+	}
+
+	size_t residentKb = getResidentKb();
+	if ( mCycle == sNumWarmUpCycles )
+		mBaselineKb = residentKb;
+	if ( ( mCycle % 100 ) == 0 )
+		console() << "cycle " << mCycle << ": " << residentKb << " kB" << endl;
+
+	if ( ++mCycle > sNumCycles )
+	{
+		size_t growthKb = residentKb > mBaselineKb ? residentKb - mBaselineKb : 0;
+		console() << "grew " << growthKb << " kB in " << sNumCycles - sNumWarmUpCycles <<
+			" cycles after the warm-up" << endl;
+		exit( growthKb > sToleranceKb ? 1 : 0 );
+	}
+}
+
+CINDER_APP_BASIC( LoadSoakTest, RendererGl(0) )
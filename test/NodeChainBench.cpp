@@ -0,0 +1,98 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Dirty tracking of a 1000 joint chain: every frame either sets the
+   transform of all joints and reads all derived positions, or sets the
+   last 3 joints and reads the tip. It only uses the Node api, so the same
+   file builds against the tree that still invalidated the children
+   recursively:
+     git worktree add ../reference 53a1be6^
+   Build it with both trees and compare the times, the checksums of the
+   derived positions have to be equal:
+     g++ -O2 -I../src -I$CINDER_PATH/include NodeChainBench.cpp ../src/Node.cpp ../src/NodeHierarchy.cpp
+     g++ -O2 -I../reference/src -I$CINDER_PATH/include NodeChainBench.cpp \
+       ../reference/src/Node.cpp ../reference/src/NodeHierarchy.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "Node.h"
+
+using namespace ci;
+using namespace std;
+using namespace mndl;
+
+typedef chrono::steady_clock Clock;
+
+static const size_t sNumJoints = 1000;
+
+static Quatf sOrientations[ 64 ];
+
+static void setJoint( const NodeRef &joint, size_t frame )
+{
+	joint->setOrientation( sOrientations[ frame & 63 ] );
+	joint->setPosition( Vec3f( 0.0f, 1.0f, 0.0f ) );
+	joint->setScale( Vec3f( 1.0f, 1.0f, 1.0f ) );
+}
+
+int main()
+{
+	for ( size_t q = 0; q < 64; ++q )
+		sOrientations[ q ] = Quatf( Vec3f( 0.0f, 0.0f, 1.0f ), 0.01f * q );
+
+	vector< NodeRef > chain( sNumJoints );
+	for ( size_t j = 0; j < sNumJoints; ++j )
+	{
+		chain[ j ] = NodeRef( new Node() );
+		if ( j > 0 )
+		{
+			chain[ j ]->setParent( chain[ j - 1 ] );
+			chain[ j - 1 ]->addChild( chain[ j ] );
+		}
+	}
+
+	// all joints animated
+	const int numAllFrames = 100;
+	double checksum = 0.0;
+	Clock::time_point start = Clock::now();
+	for ( int f = 0; f < numAllFrames; ++f )
+	{
+		for ( size_t j = 0; j < sNumJoints; ++j )
+			setJoint( chain[ j ], f + j );
+		checksum = 0.0;
+		for ( size_t j = 0; j < sNumJoints; ++j )
+			checksum += chain[ j ]->getDerivedPosition().x;
+	}
+	double allSeconds = chrono::duration< double >( Clock::now() - start ).count() / numAllFrames;
+	printf( "set all %zu joints: %9.3f ms/frame, checksum %.4f\n", sNumJoints, allSeconds * 1e3, checksum );
+
+	// only the end of the chain animated, like a hand below an arm at rest
+	const int numTipFrames = 200000;
+	double tipChecksum = 0.0;
+	start = Clock::now();
+	for ( int f = 0; f < numTipFrames; ++f )
+	{
+		for ( size_t j = sNumJoints - 3; j < sNumJoints; ++j )
+			setJoint( chain[ j ], f + j );
+		tipChecksum += chain.back()->getDerivedPosition().x;
+	}
+	double tipSeconds = chrono::duration< double >( Clock::now() - start ).count() / numTipFrames;
+	printf( "set last 3 joints:  %9.3f us/frame, checksum %.4f\n", tipSeconds * 1e6, tipChecksum );
+	return 0;
+}
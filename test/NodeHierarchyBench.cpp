@@ -0,0 +1,108 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Node transform updates in scenes of 100 to 100000 nodes. The scenes are
+   made of 50 joint characters below one root, each a spine of 10 with 4
+   limbs of 10 hanging from its end, and every frame sets the orientation
+   of all nodes and reads all derived transforms. It only uses the Node
+   api, so the same file builds against the pointer tree the nodes were
+   before they were stored in a NodeHierarchy:
+     git worktree add ../reference ae65bee^
+   Build it with both trees and compare the times, the checksums of the
+   derived transforms have to be equal:
+     g++ -O2 -I../src -I$CINDER_PATH/include NodeHierarchyBench.cpp ../src/Node.cpp ../src/NodeHierarchy.cpp
+     g++ -O2 -I../reference/src -I$CINDER_PATH/include NodeHierarchyBench.cpp ../reference/src/Node.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "Node.h"
+
+using namespace ci;
+using namespace std;
+using namespace mndl;
+
+typedef chrono::steady_clock Clock;
+
+// returns the nodes of the scene in depth-first order, the root first
+static vector< NodeRef > createScene( size_t numNodes )
+{
+	vector< int > parents( numNodes, -1 );
+	size_t i = 1;
+	while ( i < numNodes )
+	{
+		// spine, then the limbs from its last joint
+		size_t spineEnd = i + 9;
+		parents[ i++ ] = 0;
+		for ( int k = 1; ( k < 10 ) && ( i < numNodes ); ++k, ++i )
+			parents[ i ] = int( i - 1 );
+		for ( int l = 0; ( l < 4 ) && ( i < numNodes ); ++l )
+		{
+			parents[ i++ ] = int( spineEnd );
+			for ( int k = 1; ( k < 10 ) && ( i < numNodes ); ++k, ++i )
+				parents[ i ] = int( i - 1 );
+		}
+	}
+
+	vector< NodeRef > nodes( numNodes );
+	for ( size_t n = 0; n < numNodes; ++n )
+	{
+		nodes[ n ] = NodeRef( new Node() );
+		if ( parents[ n ] >= 0 )
+		{
+			nodes[ n ]->setParent( nodes[ parents[ n ] ] );
+			nodes[ parents[ n ] ]->addChild( nodes[ n ] );
+		}
+		nodes[ n ]->setPosition( Vec3f( 0.1f, 0.2f, 0.3f ) );
+	}
+	return nodes;
+}
+
+int main()
+{
+	vector< Quatf > orientations( 1024 );
+	for ( size_t q = 0; q < orientations.size(); ++q )
+		orientations[ q ] = Quatf( Vec3f( 0.0f, 1.0f, 0.0f ), 0.001f * q );
+
+	const size_t nodeCounts[] = { 100, 1000, 10000, 100000 };
+	for ( size_t c = 0; c < 4; ++c )
+	{
+		const size_t numNodes = nodeCounts[ c ];
+		const int numFrames = int( 200000 / numNodes ) + 3;
+		vector< NodeRef > nodes = createScene( numNodes );
+
+		double checksum = 0.0;
+		Clock::time_point start = Clock::now();
+		for ( int f = 0; f < numFrames; ++f )
+		{
+			for ( size_t n = 0; n < numNodes; ++n )
+				nodes[ n ]->setOrientation( orientations[ ( f + n ) & 1023 ] );
+			checksum = 0.0;
+			for ( size_t n = 0; n < numNodes; ++n )
+			{
+				const Matrix44f &m = nodes[ n ]->getDerivedTransform();
+				checksum += m.m[ 12 ] + m.m[ 13 ] * 2.0 + m.m[ 14 ] * 3.0;
+			}
+		}
+		double seconds = chrono::duration< double >( Clock::now() - start ).count() / numFrames;
+
+		printf( "%6zu nodes: %9.3f ms/frame, checksum %.4f\n", numNodes, seconds * 1e3, checksum );
+	}
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Bone palette build of a synthetic 200-bone rig: the per-frame name
+   lookup the loader used to do per bone against the bone-to-joint table
+   resolved at load. UpdateBench.cpp times the whole update() of a real
+   model against the tree before the change.
+   Build with:
+     g++ -O2 -I../src -I$CINDER_PATH/include PaletteBench.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cinder/Utilities.h"
+
+#include "AssimpLoader.h"
+
+using namespace ci;
+using namespace std;
+using namespace mndl::assimp;
+
+typedef chrono::steady_clock Clock;
+
+// joint transforms as the nodes store them, rebuilt per query like the old getDerivedTransform()
+struct Joint
+{
+	Matrix44f getDerivedTransform() const
+	{
+		Matrix44f m = Matrix44f::createScale( mScale );
+		m *= mOrientation.toMatrix44();
+		m.setTranslate( mPosition );
+		return m;
+	}
+
+	Vec3f mPosition;
+	Quatf mOrientation;
+	Vec3f mScale;
+};
+
+int main()
+{
+	const size_t numBones = 200;
+	const int numFrames = 50000;
+
+	vector< Joint > joints( numBones );
+	vector< aiBone > bones( numBones );
+	map< string, size_t > jointIndices;
+	for ( size_t i = 0; i < numBones; ++i )
+	{
+		string name = "mixamorig_Skeleton_Joint_" + toString( i );
+		joints[ i ].mPosition = Vec3f( 0.0f, 0.1f * i, 0.0f );
+		joints[ i ].mOrientation = Quatf( Vec3f( 0.0f, 0.0f, 1.0f ), 0.01f * i );
+		joints[ i ].mScale = Vec3f::one();
+		jointIndices[ name ] = i;
+		bones[ i ].mName.Set( name );
+		aiMatrix4x4::Translation( aiVector3D( 0.0f, -0.1f * i, 0.0f ), bones[ i ].mOffsetMatrix );
+	}
+
+	// per frame: name lookup, matrix rebuild, conversion and multiply in assimp types per bone
+	vector< aiMatrix4x4 > oldPalette( numBones );
+	Clock::time_point start = Clock::now();
+	for ( int f = 0; f < numFrames; ++f )
+	{
+		for ( size_t a = 0; a < numBones; ++a )
+		{
+			const aiBone *bone = &bones[ a ];
+			map< string, size_t >::const_iterator it = jointIndices.find( fromAssimp( bone->mName ) );
+			oldPalette[ a ] = toAssimp( joints[ it->second ].getDerivedTransform() ) * bone->mOffsetMatrix;
+		}
+	}
+	double oldSeconds = chrono::duration< double >( Clock::now() - start ).count() / numFrames;
+
+	// resolved at load: joint index and offset per bone, joint matrices built once per frame
+	vector< size_t > boneJoints( numBones );
+	vector< Matrix44f > boneOffsets( numBones );
+	for ( size_t a = 0; a < numBones; ++a )
+	{
+		boneJoints[ a ] = jointIndices[ fromAssimp( bones[ a ].mName ) ];
+		boneOffsets[ a ] = fromAssimp( bones[ a ].mOffsetMatrix );
+	}
+	vector< Matrix44f > jointTransforms( numBones );
+	vector< Matrix44f > palette( numBones );
+	start = Clock::now();
+	for ( int f = 0; f < numFrames; ++f )
+	{
+		for ( size_t i = 0; i < numBones; ++i )
+			jointTransforms[ i ] = joints[ i ].getDerivedTransform();
+		for ( size_t a = 0; a < numBones; ++a )
+			palette[ a ] = jointTransforms[ boneJoints[ a ] ] * boneOffsets[ a ];
+	}
+	double newSeconds = chrono::duration< double >( Clock::now() - start ).count() / numFrames;
+
+	// the palette multiplies alone, the joint matrices are shared by all meshes of a model
+	start = Clock::now();
+	for ( int f = 0; f < numFrames; ++f )
+	{
+		for ( size_t a = 0; a < numBones; ++a )
+			palette[ a ] = jointTransforms[ boneJoints[ a ] ] * boneOffsets[ a ];
+	}
+	double paletteSeconds = chrono::duration< double >( Clock::now() - start ).count() / numFrames;
+
+	float maxError = 0.0f;
+	for ( size_t a = 0; a < numBones; ++a )
+	{
+		Matrix44f m = fromAssimp( oldPalette[ a ] );
+		for ( int k = 0; k < 16; ++k )
+			maxError = math< float >::max( maxError, math< float >::abs( m.m[ k ] - palette[ a ].m[ k ] ) );
+	}
+
+	printf( "%zu bones: name lookup %.2f us/frame, resolved table %.2f us/frame (palette multiplies %.2f us), "
+			"%.1fx, max difference %g\n", numBones, oldSeconds * 1e6, newSeconds * 1e6, paletteSeconds * 1e6,
+			oldSeconds / newSeconds, maxError );
+	return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Throughput of the skinning kernels on a random 300000 vertex mesh with
+   4 influences per vertex and normals, in vertices per second against the
+   scalar loop the loader skinned with before the kernels, which blends the
+   bone matrices per vertex. Every kernel the cpu supports is run and
+   compared with the scalar loop.
+   Build with:
+     g++ -O2 -I../src -I$CINDER_PATH/include SkinningKernelBench.cpp ../src/SkinningKernels.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "cinder/CinderMath.h"
+
+#include "SkinningKernels.h"
+
+using namespace ci;
+using namespace std;
+using namespace mndl::assimp;
+
+typedef chrono::steady_clock Clock;
+
+static const size_t sNumVertices = 300000;
+static const size_t sNumBones = 60;
+static const size_t sNumInfluences = 4;
+static const int sNumIterations = 20;
+
+// the per-vertex loop of the loader before the kernels
+static void skinScalarLoop( const SkinningData &data, size_t begin, size_t end )
+{
+	const size_t numInfluences = data.mNumInfluences;
+	const uint16_t *bones = data.mBones + begin * numInfluences;
+	const float *weights = data.mWeights + begin * numInfluences;
+
+	for ( size_t v = begin; v < end; ++v, bones += numInfluences, weights += numInfluences )
+	{
+		float m[ 12 ] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+						  0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+		for ( size_t i = 0; i < numInfluences; ++i )
+		{
+			const float w = weights[ i ];
+			if ( w == 0.0f )
+				break;
+
+			const float *b = data.mBoneMatrices[ bones[ i ] ].m;
+			m[ 0 ] += w * b[ 0 ];  m[ 1 ] += w * b[ 1 ];  m[ 2 ] += w * b[ 2 ];
+			m[ 3 ] += w * b[ 4 ];  m[ 4 ] += w * b[ 5 ];  m[ 5 ] += w * b[ 6 ];
+			m[ 6 ] += w * b[ 8 ];  m[ 7 ] += w * b[ 9 ];  m[ 8 ] += w * b[ 10 ];
+			m[ 9 ] += w * b[ 12 ]; m[ 10 ] += w * b[ 13 ]; m[ 11 ] += w * b[ 14 ];
+		}
+
+		const aiVector3D &p = data.mPositions[ v ];
+		data.mSkinnedPositions[ v ] = Vec3f(
+				m[ 0 ] * p.x + m[ 3 ] * p.y + m[ 6 ] * p.z + m[ 9 ],
+				m[ 1 ] * p.x + m[ 4 ] * p.y + m[ 7 ] * p.z + m[ 10 ],
+				m[ 2 ] * p.x + m[ 5 ] * p.y + m[ 8 ] * p.z + m[ 11 ] );
+
+		const aiVector3D &n = data.mNormals[ v ];
+		data.mSkinnedNormals[ v ] = Vec3f(
+				m[ 0 ] * n.x + m[ 3 ] * n.y + m[ 6 ] * n.z,
+				m[ 1 ] * n.x + m[ 4 ] * n.y + m[ 7 ] * n.z,
+				m[ 2 ] * n.x + m[ 5 ] * n.y + m[ 8 ] * n.z );
+	}
+}
+
+// returns the vertices per second of \a func over the whole mesh
+static double measure( SkinningFunc func, const SkinningData &data )
+{
+	func( data, 0, sNumVertices );
+	Clock::time_point start = Clock::now();
+	for ( int i = 0; i < sNumIterations; ++i )
+		func( data, 0, sNumVertices );
+	double seconds = chrono::duration< double >( Clock::now() - start ).count();
+	return sNumVertices * sNumIterations / seconds;
+}
+
+int main()
+{
+	mt19937 rng( 1 );
+	uniform_real_distribution< float > random( -1.0f, 1.0f );
+
+	vector< aiVector3D > positions( sNumVertices ), normals( sNumVertices );
+	for ( size_t v = 0; v < sNumVertices; ++v )
+	{
+		positions[ v ] = aiVector3D( random( rng ), random( rng ), random( rng ) );
+		normals[ v ] = aiVector3D( random( rng ), random( rng ), random( rng ) );
+	}
+
+	vector< Matrix44f > boneMatrices( sNumBones );
+	for ( size_t b = 0; b < sNumBones; ++b )
+	{
+		for ( int i = 0; i < 16; ++i )
+			boneMatrices[ b ].m[ i ] = random( rng );
+		boneMatrices[ b ].m[ 3 ] = boneMatrices[ b ].m[ 7 ] = boneMatrices[ b ].m[ 11 ] = 0.0f;
+		boneMatrices[ b ].m[ 15 ] = 1.0f;
+	}
+
+	// 3 weights sorted in decreasing order and a padding slot, like the loader stores them
+	vector< uint16_t > bones( sNumVertices * sNumInfluences, 0 );
+	vector< float > weights( sNumVertices * sNumInfluences, 0.0f );
+	for ( size_t v = 0; v < sNumVertices; ++v )
+	{
+		for ( size_t i = 0; i < 3; ++i )
+		{
+			bones[ v * sNumInfluences + i ] = uint16_t( rng() % sNumBones );
+			weights[ v * sNumInfluences + i ] = ( 3 - i ) / 6.0f;
+		}
+	}
+
+	vector< Vec3f > referencePositions( sNumVertices ), referenceNormals( sNumVertices );
+	vector< Vec3f > skinnedPositions( sNumVertices ), skinnedNormals( sNumVertices );
+	SkinningData data;
+	data.mPositions = &positions[ 0 ];
+	data.mNormals = &normals[ 0 ];
+	data.mBones = &bones[ 0 ];
+	data.mWeights = &weights[ 0 ];
+	data.mNumInfluences = sNumInfluences;
+	data.mBoneMatrices = &boneMatrices[ 0 ];
+	data.mSkinnedPositions = &referencePositions[ 0 ];
+	data.mSkinnedNormals = &referenceNormals[ 0 ];
+
+	double reference = measure( skinScalarLoop, data );
+	printf( "%zu vertices, %zu influences\n", sNumVertices, sNumInfluences );
+	printf( "  %-12s %8.1f Mvertices/s\n", "scalar loop", reference * 1e-6 );
+
+	data.mSkinnedPositions = &skinnedPositions[ 0 ];
+	data.mSkinnedNormals = &skinnedNormals[ 0 ];
+	const SkinningKernel kernels[] = { SKINNING_KERNEL_SCALAR, SKINNING_KERNEL_SSE, SKINNING_KERNEL_AVX };
+	for ( size_t k = 0; k < 3; ++k )
+	{
+		if ( !isSkinningKernelSupported( kernels[ k ] ) )
+		{
+			printf( "  %-12s not supported\n", getSkinningKernelName( kernels[ k ] ) );
+			continue;
+		}
+
+		double throughput = measure( getSkinningFunc( kernels[ k ], sNumInfluences, true ), data );
+		float maxError = 0.0f;
+		for ( size_t v = 0; v < sNumVertices; ++v )
+		{
+			maxError = math< float >::max( maxError, skinnedPositions[ v ].distance( referencePositions[ v ] ) );
+			maxError = math< float >::max( maxError, skinnedNormals[ v ].distance( referenceNormals[ v ] ) );
+		}
+		printf( "  %-12s %8.1f Mvertices/s, %5.2fx, max difference %g\n", getSkinningKernelName( kernels[ k ] ),
+				throughput * 1e-6, throughput / reference, maxError );
+	}
+	return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Times every specialization getSkinningFunc() returns, for each kernel
+   the cpu supports, 1, 2, 4 and 8 influences per vertex, with normals and
+   positions only, on a random 300000 vertex mesh. 1 and 2 influences are
+   also compared with the same vertices padded to 4, the layout the loader
+   used for every mesh before the specializations.
+   Build with:
+     g++ -O2 -I../src -I$CINDER_PATH/include SkinningSpecializationBench.cpp ../src/SkinningKernels.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "cinder/CinderMath.h"
+
+#include "SkinningKernels.h"
+
+using namespace ci;
+using namespace std;
+using namespace mndl::assimp;
+
+typedef chrono::steady_clock Clock;
+
+static const size_t sNumVertices = 300000;
+static const size_t sNumBones = 60;
+static const int sNumIterations = 20;
+
+// random mesh and palette shared by all runs
+struct Mesh
+{
+	vector< aiVector3D > mPositions;
+	vector< aiVector3D > mNormals;
+	vector< Matrix44f > mBoneMatrices;
+	vector< uint16_t > mBones;
+	vector< float > mWeights;
+};
+
+// stores \a numInfluences equal weights per vertex with a stride of \a stride
+static void setInfluences( Mesh *mesh, size_t numInfluences, size_t stride )
+{
+	mt19937 rng( 2 );
+	mesh->mBones.assign( sNumVertices * stride, 0 );
+	mesh->mWeights.assign( sNumVertices * stride, 0.0f );
+	for ( size_t v = 0; v < sNumVertices; ++v )
+	{
+		for ( size_t i = 0; i < numInfluences; ++i )
+		{
+			mesh->mBones[ v * stride + i ] = uint16_t( rng() % sNumBones );
+			mesh->mWeights[ v * stride + i ] = 1.0f / numInfluences;
+		}
+	}
+}
+
+// skins \a mesh with \a func into \a positions and \a normals and returns the vertices per second
+static double measure( SkinningFunc func, const Mesh &mesh, size_t stride, bool normals,
+		vector< Vec3f > *positions, vector< Vec3f > *skinnedNormals )
+{
+	SkinningData data;
+	data.mPositions = &mesh.mPositions[ 0 ];
+	data.mNormals = normals ? &mesh.mNormals[ 0 ] : NULL;
+	data.mBones = &mesh.mBones[ 0 ];
+	data.mWeights = &mesh.mWeights[ 0 ];
+	data.mNumInfluences = stride;
+	data.mBoneMatrices = &mesh.mBoneMatrices[ 0 ];
+	data.mSkinnedPositions = &( *positions )[ 0 ];
+	data.mSkinnedNormals = &( *skinnedNormals )[ 0 ];
+
+	func( data, 0, sNumVertices );
+	Clock::time_point start = Clock::now();
+	for ( int i = 0; i < sNumIterations; ++i )
+		func( data, 0, sNumVertices );
+	double seconds = chrono::duration< double >( Clock::now() - start ).count();
+	return sNumVertices * sNumIterations / seconds;
+}
+
+int main()
+{
+	mt19937 rng( 1 );
+	uniform_real_distribution< float > random( -1.0f, 1.0f );
+
+	Mesh mesh;
+	mesh.mPositions.resize( sNumVertices );
+	mesh.mNormals.resize( sNumVertices );
+	for ( size_t v = 0; v < sNumVertices; ++v )
+	{
+		mesh.mPositions[ v ] = aiVector3D( random( rng ), random( rng ), random( rng ) );
+		mesh.mNormals[ v ] = aiVector3D( random( rng ), random( rng ), random( rng ) );
+	}
+	mesh.mBoneMatrices.resize( sNumBones );
+	for ( size_t b = 0; b < sNumBones; ++b )
+	{
+		for ( int i = 0; i < 16; ++i )
+			mesh.mBoneMatrices[ b ].m[ i ] = random( rng );
+		mesh.mBoneMatrices[ b ].m[ 3 ] = mesh.mBoneMatrices[ b ].m[ 7 ] = mesh.mBoneMatrices[ b ].m[ 11 ] = 0.0f;
+		mesh.mBoneMatrices[ b ].m[ 15 ] = 1.0f;
+	}
+
+	vector< Vec3f > paddedPositions( sNumVertices ), paddedNormals( sNumVertices );
+	vector< Vec3f > positions( sNumVertices ), normals( sNumVertices );
+	const SkinningKernel kernels[] = { SKINNING_KERNEL_SCALAR, SKINNING_KERNEL_SSE, SKINNING_KERNEL_AVX };
+	const size_t influenceCounts[] = { 1, 2, 4, 8 };
+	printf( "%zu vertices\n", sNumVertices );
+	for ( size_t k = 0; k < 3; ++k )
+	{
+		if ( !isSkinningKernelSupported( kernels[ k ] ) )
+		{
+			printf( "%s not supported\n", getSkinningKernelName( kernels[ k ] ) );
+			continue;
+		}
+
+		for ( int withNormals = 1; withNormals >= 0; --withNormals )
+		{
+			for ( size_t c = 0; c < 4; ++c )
+			{
+				const size_t numInfluences = influenceCounts[ c ];
+				const size_t paddedStride = ( numInfluences <= 4 ) ? 4 : 8;
+
+				setInfluences( &mesh, numInfluences, numInfluences );
+				double specialized = measure( getSkinningFunc( kernels[ k ], numInfluences, withNormals != 0 ),
+						mesh, numInfluences, withNormals != 0, &positions, &normals );
+				printf( "  %-6s %zu influences, %-14s %7.1f Mvertices/s", getSkinningKernelName( kernels[ k ] ),
+						numInfluences, withNormals ? "normals" : "positions only", specialized * 1e-6 );
+
+				// 4 and 8 influences are stored the same way in both layouts
+				if ( numInfluences == paddedStride )
+				{
+					printf( "\n" );
+					continue;
+				}
+
+				setInfluences( &mesh, numInfluences, paddedStride );
+				double padded = measure( getSkinningFunc( kernels[ k ], paddedStride, withNormals != 0 ),
+						mesh, paddedStride, withNormals != 0, &paddedPositions, &paddedNormals );
+
+				float maxError = 0.0f;
+				for ( size_t v = 0; v < sNumVertices; ++v )
+				{
+					maxError = math< float >::max( maxError, positions[ v ].distance( paddedPositions[ v ] ) );
+					if ( withNormals )
+						maxError = math< float >::max( maxError, normals[ v ].distance( paddedNormals[ v ] ) );
+				}
+				printf( ", padded to %zu %7.1f, %5.2fx, max difference %g\n", paddedStride, padded * 1e-6,
+						specialized / padded, maxError );
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Scaling of the skinning of one model from 1 to N skinning threads, N
+   being the number of hardware threads or the second argument. Every
+   frame advances the clip, the skinning time the loader measures is
+   reported with the number of vertices it skinned per second. The third
+   argument sets the chunk size, 16384 by default.
+   Build it as a Cinder application with the block's src/ files and the
+   assimp library, like samples/SkinningApp, and run it with:
+     SkinningThreadsBench ../samples/SkinningApp/assets/seymour.dae
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "cinder/app/AppBasic.h"
+
+#include "AssimpLoader.h"
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+using namespace mndl;
+
+class SkinningThreadsBench : public AppBasic
+{
+	public:
+		void setup();
+};
+
+static const int sNumWarmUpFrames = 20;
+static const int sNumFrames = 200;
+
+void SkinningThreadsBench::setup()
+{
+	const vector< string > &args = getArgs();
+	if ( args.size() < 2 )
+	{
+		console() << "usage: SkinningThreadsBench model [threads] [chunk size]" << endl;
+		exit( 2 );
+	}
+	size_t maxThreads = ( args.size() > 2 ) ? size_t( atoi( args[ 2 ].c_str() ) ) :
+		thread::hardware_concurrency();
+	maxThreads = math< size_t >::max( maxThreads, 1 );
+
+	assimp::AssimpLoader loader( args[ 1 ] );
+	loader.setAnimation( 0 );
+	loader.enableAnimation();
+	loader.enableSkinning();
+	loader.disableRigidMeshes();
+	if ( args.size() > 3 )
+		loader.setSkinningChunkSize( size_t( atoi( args[ 3 ].c_str() ) ) );
+
+	double duration = loader.getAnimationDuration( 0 );
+	printf( "%s, chunks of %zu vertices\n", args[ 1 ].c_str(), loader.getSkinningChunkSize() );
+	double single = 0.0;
+	for ( size_t t = 1; t <= maxThreads; ++t )
+	{
+		loader.setNumSkinningThreads( t );
+
+		double seconds = 0.0;
+		size_t numVertices = 0;
+		for ( int f = 0; f < sNumWarmUpFrames + sNumFrames; ++f )
+		{
+			loader.setTime( fmod( f / 60.0, duration ) );
+			loader.update();
+			if ( f < sNumWarmUpFrames )
+				continue;
+			seconds += loader.getSkinningSeconds();
+			numVertices += loader.getNumSkinnedVertices();
+		}
+		if ( t == 1 )
+			single = seconds;
+		printf( "  %2zu threads: %8.3f ms/frame, %7.1f Mvertices/s, speedup %5.2fx\n", t,
+				seconds / sNumFrames * 1e3, numVertices / seconds * 1e-6, single / seconds );
+	}
+	exit( 0 );
+}
+
+CINDER_APP_BASIC( SkinningThreadsBench, RendererGl(0) )
@@ -0,0 +1,123 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Skins a model with 1, 2 and N skinning threads, N being the number of
+   hardware threads but at least 4, and compares the vertex and normal
+   arrays of every mesh with memcmp against the single threaded output
+   over 200 frames of the first clip. The chunk size is small, so even the
+   meshes of a sample model are split into many jobs, and all meshes are
+   skinned per vertex. Exits with 1 if any byte differs.
+   Build it as a Cinder application with the block's src/ files and the
+   assimp library, like samples/SkinningApp, and run it with the model path:
+     SkinningThreadsTest ../samples/SkinningApp/assets/seymour.dae
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "cinder/app/AppBasic.h"
+
+#include "AssimpLoader.h"
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+using namespace mndl;
+
+class SkinningThreadsTest : public AppBasic
+{
+	public:
+		void setup();
+};
+
+static const size_t sChunkSize = 64;
+static const int sNumFrames = 200;
+
+static bool isEqual( const vector< Vec3f > &a, const vector< Vec3f > &b )
+{
+	return ( a.size() == b.size() ) &&
+		( a.empty() || ( memcmp( &a[ 0 ], &b[ 0 ], a.size() * sizeof( Vec3f ) ) == 0 ) );
+}
+
+void SkinningThreadsTest::setup()
+{
+	if ( getArgs().size() < 2 )
+	{
+		console() << "usage: SkinningThreadsTest model" << endl;
+		exit( 2 );
+	}
+
+	size_t threadCounts[] = { 1, 2, math< size_t >::max( thread::hardware_concurrency(), 4 ) };
+
+	// separate loads, copies would share their meshes
+	vector< assimp::AssimpLoader > loaders;
+	loaders.reserve( 3 );
+	for ( size_t i = 0; i < 3; ++i )
+	{
+		loaders.push_back( assimp::AssimpLoader( getArgs()[ 1 ] ) );
+		assimp::AssimpLoader &loader = loaders.back();
+		loader.setAnimation( 0 );
+		loader.enableAnimation();
+		loader.enableSkinning();
+		loader.disableRigidMeshes();
+		loader.setSkinningChunkSize( sChunkSize );
+		loader.setNumSkinningThreads( threadCounts[ i ] );
+	}
+
+	double duration = loaders[ 0 ].getAnimationDuration( 0 );
+	size_t numMismatches[ 3 ] = { 0, 0, 0 };
+	size_t numSkinnedVertices = 0;
+	for ( int f = 0; f < sNumFrames; ++f )
+	{
+		for ( size_t i = 0; i < 3; ++i )
+		{
+			loaders[ i ].setTime( fmod( f / 60.0, duration ) );
+			loaders[ i ].update();
+		}
+		numSkinnedVertices += loaders[ 0 ].getNumSkinnedVertices();
+
+		for ( size_t i = 1; i < 3; ++i )
+		{
+			for ( size_t n = 0; n < loaders[ 0 ].getNumMeshes(); ++n )
+			{
+				const TriMesh &reference = loaders[ 0 ].getMesh( n );
+				const TriMesh &mesh = loaders[ i ].getMesh( n );
+				if ( !isEqual( reference.getVertices(), mesh.getVertices() ) ||
+					 !isEqual( reference.getNormals(), mesh.getNormals() ) )
+					numMismatches[ i ]++;
+			}
+		}
+	}
+
+	console() << loaders[ 0 ].getNumMeshes() << " meshes, " << numSkinnedVertices <<
+		" vertices skinned in " << sNumFrames << " frames" << endl;
+	bool passed = true;
+	for ( size_t i = 1; i < 3; ++i )
+	{
+		console() << "  " << threadCounts[ i ] << " threads: " << numMismatches[ i ] <<
+			" meshes differ from 1 thread" << endl;
+		if ( numMismatches[ i ] > 0 )
+			passed = false;
+	}
+	console() << ( passed ? "passed" : "FAILED" ) << endl;
+	exit( passed ? 0 : 1 );
+}
+
+CINDER_APP_BASIC( SkinningThreadsTest, RendererGl(0) )
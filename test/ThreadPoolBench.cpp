@@ -0,0 +1,95 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Scaling of ThreadPool::parallelFor() from 1 to the number of hardware
+   threads, or to the thread count given as the first argument, with the
+   grain size of 1 AssimpLoader::updateBatch() uses. The work is synthetic,
+   so this measures the overhead of the pool, UpdateBatchBench.cpp times
+   updateBatch() itself on loaded models.
+   Build with:
+     g++ -O2 -pthread -I../src -I$CINDER_PATH/include ThreadPoolBench.cpp ../src/ThreadPool.cpp
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// stands in for the update of one model instance
+struct InstanceWork
+{
+	InstanceWork( vector< float > *results, size_t iterations ) :
+		mResults( results ), mIterations( iterations ) {}
+
+	void operator()( size_t begin, size_t end ) const
+	{
+		for ( size_t i = begin; i < end; ++i )
+		{
+			float x = float( i );
+			for ( size_t k = 0; k < mIterations; ++k )
+				x = sqrtf( x * 1.0001f + 1.0f );
+			( *mResults )[ i ] = x;
+		}
+	}
+
+	vector< float > *mResults;
+	size_t mIterations;
+};
+
+static double runFrames( mndl::ThreadPool &pool, size_t numInstances, size_t iterations, int numFrames )
+{
+	vector< float > results( numInstances );
+	InstanceWork work( &results, iterations );
+	pool.parallelFor( 0, numInstances, work );
+
+	Clock::time_point start = Clock::now();
+	for ( int f = 0; f < numFrames; ++f )
+		pool.parallelFor( 0, numInstances, work );
+	return chrono::duration< double >( Clock::now() - start ).count() / numFrames;
+}
+
+int main( int argc, char **argv )
+{
+	size_t maxThreads = ( argc > 1 ) ? size_t( atoi( argv[ 1 ] ) ) : thread::hardware_concurrency();
+	if ( maxThreads == 0 )
+		maxThreads = 1;
+
+	const size_t numInstances = 1000;
+	const size_t workloads[] = { 0, 100, 2000 };
+	for ( size_t w = 0; w < 3; ++w )
+	{
+		printf( "%zu instances, %zu iterations each\n", numInstances, workloads[ w ] );
+		double single = 0.0;
+		for ( size_t t = 1; t <= maxThreads; ++t )
+		{
+			mndl::ThreadPool pool( t );
+			double seconds = runFrames( pool, numInstances, workloads[ w ], 200 );
+			if ( t == 1 )
+				single = seconds;
+			printf( "  %2zu threads: %8.3f ms/frame, speedup %5.2fx\n", t, seconds * 1e3,
+					single / seconds );
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Scaling of AssimpLoader::updateBatch() from 1 to N threads. Loads the
+   model given as the first argument as 1000 separate instances, or as the
+   number given as the second argument, and times the animated and skinned
+   batch update with every thread count up to the number of hardware
+   threads, or to the third argument.
+   Build it as a Cinder application with the block's src/ files and the
+   assimp library, like samples/AssimpApp, and run it with:
+     UpdateBatchBench ../samples/AssimpApp/assets/astroboy_walk.dae 1000
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "cinder/app/AppBasic.h"
+#include "cinder/Timer.h"
+
+#include "AssimpLoader.h"
+#include "ThreadPool.h"
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+using namespace mndl;
+
+class UpdateBatchBench : public AppBasic
+{
+	public:
+		void setup();
+
+	private:
+		double runFrames( ThreadPool &pool, int numFrames );
+
+		vector< assimp::AssimpLoader > mLoaders;
+		vector< assimp::AssimpInstance > mInstances;
+};
+
+void UpdateBatchBench::setup()
+{
+	const vector< string > &args = getArgs();
+	if ( args.size() < 2 )
+	{
+		console() << "usage: UpdateBatchBench model [instances] [threads]" << endl;
+		exit( 2 );
+	}
+	size_t numInstances = ( args.size() > 2 ) ? size_t( atoi( args[ 2 ].c_str() ) ) : 1000;
+	size_t maxThreads = ( args.size() > 3 ) ? size_t( atoi( args[ 3 ].c_str() ) ) :
+		thread::hardware_concurrency();
+	maxThreads = math< size_t >::max( maxThreads, 1 );
+
+	// copies of a loader share their nodes, updateBatch() needs separate loads
+	mLoaders.reserve( numInstances );
+	for ( size_t i = 0; i < numInstances; ++i )
+	{
+		mLoaders.push_back( assimp::AssimpLoader( args[ 1 ] ) );
+		assimp::AssimpLoader &loader = mLoaders.back();
+		loader.setAnimation( 0 );
+		loader.enableAnimation();
+		loader.enableSkinning();
+	}
+
+	// the instances are spread over the clip, so they are in different poses
+	double duration = mLoaders[ 0 ].getAnimationDuration( 0 );
+	for ( size_t i = 0; i < numInstances; ++i )
+		mInstances.push_back( assimp::AssimpInstance( &mLoaders[ i ], duration * i / numInstances ) );
+
+	printf( "%zu instances of %s\n", numInstances, args[ 1 ].c_str() );
+	double single = 0.0;
+	for ( size_t t = 1; t <= maxThreads; ++t )
+	{
+		ThreadPool pool( t );
+		runFrames( pool, 10 );
+		double seconds = runFrames( pool, 100 );
+		if ( t == 1 )
+			single = seconds;
+		printf( "  %2zu threads: %8.3f ms/frame, speedup %5.2fx\n", t, seconds * 1e3,
+				single / seconds );
+	}
+	exit( 0 );
+}
+
+double UpdateBatchBench::runFrames( ThreadPool &pool, int numFrames )
+{
+	Timer timer;
+	timer.start();
+	for ( int f = 0; f < numFrames; ++f )
+	{
+		for ( size_t i = 0; i < mInstances.size(); ++i )
+			mInstances[ i ].mTime += 1.0 / 60.0;
+		assimp::AssimpLoader::updateBatch( mInstances, pool );
+	}
+	timer.stop();
+	return timer.getSeconds() / numFrames;
+}
+
+CINDER_APP_BASIC( UpdateBatchBench, RendererGl(0) )
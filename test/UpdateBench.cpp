@@ -0,0 +1,106 @@
+/*
+ Copyright (C) 2011-2012 Gabor Papp
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published
+ by the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Times AssimpLoader::update() of the animated and skinned model given as
+   the first argument, the seymour.dae asset by default, over 1000 frames
+   of the first clip. It only uses the public api of the loader, so the same file
+   builds against an older tree; the reference for the bone bindings
+   resolved at load is the tree before that change:
+     git worktree add ../reference e736981^
+   Build it twice as a Cinder application with the block's src/ files and
+   the assimp library, like samples/SkinningApp, once with ../src and once
+   with ../reference/src, and run both with:
+     UpdateBench ../samples/SkinningApp/assets/seymour.dae
+   The checksum of the skinned vertices of the last frame has to agree
+   between the two up to float rounding. Newer trees keep the vertices of
+   meshes bound to a single bone in bind pose, build the current tree with
+   -DUPDATE_BENCH_SKIN_ALL to skin every mesh like the reference does.
+ */
+
+#include <cstdio>
+#include <vector>
+
+#include "cinder/app/AppBasic.h"
+#include "cinder/Timer.h"
+
+#include "AssimpLoader.h"
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+using namespace mndl;
+
+class UpdateBench : public AppBasic
+{
+	public:
+		void setup();
+};
+
+static const int sNumWarmUpFrames = 60;
+static const int sNumFrames = 1000;
+
+void UpdateBench::setup()
+{
+	const vector< string > &args = getArgs();
+	fs::path modelPath = ( args.size() > 1 ) ? fs::path( args[ 1 ] ) :
+		getAssetPath( "seymour.dae" );
+
+	assimp::AssimpLoader loader( modelPath );
+	loader.setAnimation( 0 );
+	loader.enableAnimation();
+	loader.enableSkinning();
+#ifdef UPDATE_BENCH_SKIN_ALL
+	loader.disableRigidMeshes();
+#endif
+
+	double duration = loader.getAnimationDuration( 0 );
+	for ( int f = 0; f < sNumWarmUpFrames; ++f )
+	{
+		loader.setTime( fmod( f / 60.0, duration ) );
+		loader.update();
+	}
+
+	Timer timer;
+	double minSeconds = 1e10;
+	double totalSeconds = 0.0;
+	for ( int f = 0; f < sNumFrames; ++f )
+	{
+		loader.setTime( fmod( f / 60.0, duration ) );
+		timer.start();
+		loader.update();
+		timer.stop();
+		minSeconds = math< double >::min( minSeconds, timer.getSeconds() );
+		totalSeconds += timer.getSeconds();
+	}
+
+	// pose of the last frame, identical output is part of the comparison
+	double checksum = 0.0;
+	for ( size_t n = 0; n < loader.getNumMeshes(); ++n )
+	{
+		const vector< Vec3f > &vertices = loader.getMesh( n ).getVertices();
+		for ( size_t v = 0; v < vertices.size(); ++v )
+			checksum += vertices[ v ].x + vertices[ v ].y * 2.0 + vertices[ v ].z * 3.0;
+	}
+
+	printf( "%s, %zu meshes\n", modelPath.string().c_str(), loader.getNumMeshes() );
+	printf( "  update(): %8.4f ms/frame mean, %8.4f ms min, checksum %.6f\n",
+			totalSeconds / sNumFrames * 1e3, minSeconds * 1e3, checksum );
+	exit( 0 );
+}
+
+CINDER_APP_BASIC( UpdateBench, RendererGl(0) )